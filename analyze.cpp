@@ -0,0 +1,311 @@
+#include "analyze.h"
+#include "disasm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+namespace {
+
+bool is_skip(uint16_t opcode){
+    switch (opcode & 0xF000) {
+        case 0x3000: case 0x4000: case 0x5000: case 0x9000:
+            return true;
+        case 0xE000:
+            return (opcode & 0x00FF) == 0x9E || (opcode & 0x00FF) == 0xA1;
+    }
+    return false;
+}
+
+// Instructions after which the next address is not reached by falling through.
+bool ends_flow(uint16_t opcode){
+    return (opcode & 0xF000) == 0x1000 || (opcode & 0xF000) == 0xB000 || opcode == 0x00EE;
+}
+
+std::string hex(uint16_t v, int digits = 3){
+    char buf[8];
+    snprintf(buf, sizeof(buf), "%0*X", digits, v);
+    return buf;
+}
+
+} // namespace
+
+rom_analysis analyze_rom_chip8(const uint8_t *program, size_t n){
+    rom_analysis a;
+    if(n > 0x1000 - 0x200)
+        n = 0x1000 - 0x200;
+    a.rom_end = (uint16_t)(0x200 + n);
+    a.memory.assign(0x1000, 0);
+    memcpy(a.memory.data() + 0x200, program, n);
+    a.code.assign(0x1000, 0);
+    a.leader.assign(0x1000, 0);
+
+    std::set<uint16_t> invalid;       // addresses control reaches that are not valid code
+    std::set<uint16_t> call_targets;
+    std::set<uint16_t> data_refs;
+    std::vector<uint16_t> work = {0x200};
+    a.leader[0x200] = 1;
+
+    // recursive descent over every reachable instruction
+    while(!work.empty()){
+        uint16_t pc = work.back();
+        work.pop_back();
+        if(pc < 0x200 || pc + 2 > a.rom_end){
+            invalid.insert(pc);
+            continue;
+        }
+        if(a.code[pc] == 1)
+            continue;
+        uint16_t opcode = a.opcode(pc);
+        if(!known_opcode_chip8(opcode)){
+            invalid.insert(pc);
+            continue;
+        }
+        a.code[pc] = 1;
+        if(a.code[pc+1] != 1)
+            a.code[pc+1] = 2;
+
+        uint16_t nnn = opcode & 0x0FFF;
+        switch (opcode & 0xF000) {
+            case 0x1000:
+                a.leader[nnn] = 1;
+                work.push_back(nnn);
+                break;
+            case 0x2000:
+                call_targets.insert(nnn);
+                a.leader[nnn] = 1;
+                work.push_back(nnn);
+                a.leader[(pc + 2) & 0xFFF] = 1; // return site
+                work.push_back(pc + 2);
+                break;
+            case 0xA000:
+                data_refs.insert(nnn);
+                work.push_back(pc + 2);
+                break;
+            case 0xB000:
+                a.indirect_jumps.push_back(pc);
+                break;
+            default:
+                if(opcode == 0x00EE)
+                    break;
+                if(is_skip(opcode)){
+                    a.leader[(pc + 2) & 0xFFF] = 1;
+                    a.leader[(pc + 4) & 0xFFF] = 1;
+                    work.push_back(pc + 4);
+                }
+                work.push_back(pc + 2);
+        }
+    }
+    std::sort(a.indirect_jumps.begin(), a.indirect_jumps.end());
+    a.data_refs.assign(data_refs.begin(), data_refs.end());
+
+    // basic blocks
+    for(uint16_t start=0x200;start<a.rom_end;start++){
+        if(a.code[start] != 1 || !a.leader[start])
+            continue;
+        cfg_block b;
+        b.start = start;
+        uint16_t pc = start;
+        for(;;){
+            uint16_t opcode = a.opcode(pc);
+            uint16_t next = pc + 2;
+            if((opcode & 0xF000) == 0x1000){
+                b.halts = (opcode & 0x0FFF) == pc;
+                if(!b.halts)
+                    b.succ.push_back(opcode & 0x0FFF);
+                b.invalid = invalid.count(opcode & 0x0FFF) != 0;
+            }
+            else if((opcode & 0xF000) == 0x2000){
+                b.call = opcode & 0x0FFF;
+                b.succ.push_back(next);
+                b.invalid = invalid.count(next) != 0;
+            }
+            else if(opcode == 0x00EE)
+                b.returns = true;
+            else if((opcode & 0xF000) == 0xB000)
+                b.indirect = true;
+            else if(is_skip(opcode)){
+                b.succ.push_back(next);
+                b.succ.push_back(next + 2);
+                b.invalid = invalid.count(next) || invalid.count(next + 2);
+            }
+            if((opcode & 0xF000) == 0x2000 || ends_flow(opcode) || is_skip(opcode)){
+                b.end = next;
+                break;
+            }
+            if(next >= a.rom_end || a.code[next] != 1){
+                b.end = next;
+                b.invalid = true; // ran off the ROM or into an unknown opcode
+                break;
+            }
+            if(a.leader[next]){
+                b.end = next;
+                b.succ.push_back(next);
+                break;
+            }
+            pc = next;
+        }
+        // successors that are not code (invalid) are dropped so every succ names a block
+        b.succ.erase(std::remove_if(b.succ.begin(), b.succ.end(),
+                                    [&](uint16_t s){ return s >= 0x1000 || a.code[s] != 1; }), b.succ.end());
+        a.blocks[start] = b;
+    }
+
+    // functions: blocks reachable from each entry without following calls
+    std::vector<uint16_t> entries = {0x200};
+    for(uint16_t t : call_targets)
+        if(t < 0x1000 && a.code[t] == 1 && t != 0x200)
+            entries.push_back(t);
+    for(uint16_t entry : entries){
+        cfg_function f;
+        f.entry = entry;
+        std::set<uint16_t> seen, callees;
+        std::vector<uint16_t> todo = {entry};
+        while(!todo.empty()){
+            uint16_t s = todo.back();
+            todo.pop_back();
+            if(!seen.insert(s).second)
+                continue;
+            auto it = a.blocks.find(s);
+            if(it == a.blocks.end())
+                continue;
+            if(it->second.call && a.code[it->second.call] == 1)
+                callees.insert(it->second.call);
+            for(uint16_t next : it->second.succ)
+                todo.push_back(next);
+        }
+        f.blocks.assign(seen.begin(), seen.end());
+        f.callees.assign(callees.begin(), callees.end());
+        a.functions[entry] = f;
+    }
+    return a;
+}
+
+std::string analysis_text(const rom_analysis &a){
+    std::string out;
+    char line[128];
+    std::set<uint16_t> refs(a.data_refs.begin(), a.data_refs.end());
+    uint16_t pc = 0x200;
+    while(pc < a.rom_end){
+        if(a.code[pc] == 1){
+            if(a.functions.count(pc))
+                out += "\n" + std::string(pc == 0x200 ? "main" : "sub_" + hex(pc)) + ":\n";
+            else if(a.blocks.count(pc))
+                out += "L_" + hex(pc) + ":\n";
+            uint16_t opcode = a.opcode(pc);
+            char text[32];
+            disassemble_chip8(opcode, text, sizeof(text));
+            snprintf(line, sizeof(line), "    %03X  %04X  %s", pc, opcode, text);
+            out += line;
+            if((opcode & 0xF000) == 0xB000)
+                out += "    ; indirect";
+            if((opcode & 0xF000) == 0x1000 && (opcode & 0x0FFF) == pc)
+                out += "    ; halt";
+            out += "\n";
+            pc += 2;
+            continue;
+        }
+        // data: up to 8 bytes per line, a new line at every referenced address
+        snprintf(line, sizeof(line), "    %03X        db", pc);
+        out += line;
+        int count = 0;
+        bool sprite = refs.count(pc) != 0;
+        do{
+            snprintf(line, sizeof(line), " %02X", a.memory[pc]);
+            out += line;
+            pc++;
+            count++;
+        } while(pc < a.rom_end && a.code[pc] != 1 && count < 8 && !refs.count(pc));
+        out += sprite ? "    ; referenced by LD I\n" : "\n";
+    }
+    return out;
+}
+
+std::string analysis_dot(const rom_analysis &a){
+    std::string out = "digraph rom {\n  node [shape=box, fontname=\"monospace\"];\n";
+    for(auto &[entry, f] : a.functions){
+        std::string name = entry == 0x200 ? "main" : "sub_" + hex(entry);
+        out += "  subgraph cluster_" + hex(entry) + " {\n    label=\"" + name + "\";\n";
+        for(uint16_t s : f.blocks){
+            const cfg_block &b = a.blocks.at(s);
+            std::string label;
+            for(uint16_t pc=b.start;pc<b.end;pc+=2){
+                char text[32];
+                disassemble_chip8(a.opcode(pc), text, sizeof(text));
+                label += hex(pc) + "  " + text + "\\l";
+            }
+            // blocks shared by several functions are drawn in the first one only
+            if(a.functions.begin()->first != entry){
+                bool drawn = false;
+                for(auto &[e2, f2] : a.functions){
+                    if(e2 == entry)
+                        break;
+                    if(std::binary_search(f2.blocks.begin(), f2.blocks.end(), s))
+                        drawn = true;
+                }
+                if(drawn)
+                    continue;
+            }
+            out += "    b_" + hex(s) + " [label=\"" + label + "\"";
+            if(b.indirect || b.invalid)
+                out += ", color=red";
+            out += "];\n";
+        }
+        out += "  }\n";
+    }
+    for(auto &[s, b] : a.blocks){
+        for(uint16_t next : b.succ)
+            out += "  b_" + hex(s) + " -> b_" + hex(next) + ";\n";
+        if(b.call && a.blocks.count(b.call))
+            out += "  b_" + hex(s) + " -> b_" + hex(b.call) + " [style=dashed];\n";
+    }
+    out += "}\n";
+    return out;
+}
+
+std::string analysis_json(const rom_analysis &a){
+    auto list = [](const std::vector<uint16_t> &v){
+        std::string s = "[";
+        for(size_t i=0;i<v.size();i++)
+            s += (i ? ", " : "") + std::to_string(v[i]);
+        return s + "]";
+    };
+    std::string out = "{\n  \"rom_start\": 512,\n  \"rom_end\": " + std::to_string(a.rom_end) + ",\n  \"blocks\": [\n";
+    size_t i = 0;
+    for(auto &[s, b] : a.blocks){
+        out += "    {\"start\": " + std::to_string(b.start) + ", \"end\": " + std::to_string(b.end) +
+               ", \"succ\": " + list(b.succ);
+        if(b.call)
+            out += ", \"call\": " + std::to_string(b.call);
+        if(b.returns)
+            out += ", \"returns\": true";
+        if(b.halts)
+            out += ", \"halts\": true";
+        if(b.indirect)
+            out += ", \"indirect\": true";
+        if(b.invalid)
+            out += ", \"invalid\": true";
+        out += ++i < a.blocks.size() ? "},\n" : "}\n";
+    }
+    out += "  ],\n  \"functions\": [\n";
+    i = 0;
+    for(auto &[entry, f] : a.functions)
+        out += "    {\"entry\": " + std::to_string(entry) + ", \"blocks\": " + list(f.blocks) +
+               ", \"callees\": " + list(f.callees) + (++i < a.functions.size() ? "},\n" : "}\n");
+    out += "  ],\n  \"data\": [";
+    bool first = true;
+    for(uint16_t pc=0x200;pc<a.rom_end;){
+        if(a.code[pc]){
+            pc++;
+            continue;
+        }
+        uint16_t start = pc;
+        while(pc < a.rom_end && !a.code[pc])
+            pc++;
+        out += std::string(first ? "" : ", ") + "{\"start\": " + std::to_string(start) + ", \"end\": " + std::to_string(pc) + "}";
+        first = false;
+    }
+    out += "],\n  \"data_refs\": " + list(a.data_refs) + ",\n  \"indirect_jumps\": " + list(a.indirect_jumps) + "\n}\n";
+    return out;
+}
@@ -0,0 +1,55 @@
+#ifndef CHIP8_EMULATOR_ANALYZE_H
+#define CHIP8_EMULATOR_ANALYZE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Static ROM analysis: recursive-descent disassembly from 0x200, split into basic blocks,
+// functions (0x200 plus every 2NNN target) and a call graph. Bytes never reached as code are
+// data; ANNN operands are recorded as data references (usually sprites).
+//
+// Control flow the analysis cannot follow is recorded rather than guessed: BNNN is an indirect
+// jump, and code is not followed past the ROM image or into unknown opcodes.
+
+struct cfg_block {
+    uint16_t start;
+    uint16_t end;                // one past the last instruction byte
+    std::vector<uint16_t> succ;  // successor blocks inside the same function
+    uint16_t call = 0;           // 2NNN target when the block ends in a call
+    bool returns = false;        // ends in 00EE
+    bool halts = false;          // ends in a jump to itself
+    bool indirect = false;       // ends in BNNN
+    bool invalid = false;        // ends before an unknown opcode or outside the ROM
+};
+
+struct cfg_function {
+    uint16_t entry;
+    std::vector<uint16_t> blocks;  // block starts, ascending
+    std::vector<uint16_t> callees;
+};
+
+struct rom_analysis {
+    uint16_t rom_end;                          // 0x200 + ROM size
+    std::vector<uint8_t> memory;               // 4KB image with the ROM at 0x200
+    std::vector<uint8_t> code;                 // per address: 1 = first byte of an instruction, 2 = second byte
+    std::vector<uint8_t> leader;               // per address: 1 = a basic block starts here
+    std::map<uint16_t, cfg_block> blocks;
+    std::map<uint16_t, cfg_function> functions;
+    std::vector<uint16_t> data_refs;           // ANNN targets, sorted, unique
+    std::vector<uint16_t> indirect_jumps;      // BNNN sites
+
+    uint16_t opcode(uint16_t addr) const { return memory[addr & 0xFFF]<<8 | memory[(addr+1) & 0xFFF]; }
+    bool is_code(uint16_t addr) const { return addr < 0x1000 && code[addr] != 0; }
+};
+
+rom_analysis analyze_rom_chip8(const uint8_t *program, size_t n);
+
+// Output formats. Text is an annotated listing, DOT one cluster per function with call edges
+// dashed, JSON has blocks, functions, call graph and data ranges.
+std::string analysis_text(const rom_analysis &a);
+std::string analysis_dot(const rom_analysis &a);
+std::string analysis_json(const rom_analysis &a);
+
+#endif //CHIP8_EMULATOR_ANALYZE_H
@@ -0,0 +1,121 @@
+#include "audio.h"
+
+#include <chrono>
+
+beep_synth::beep_synth(uint32_t sample_rate, uint32_t frequency, int16_t amplitude)
+    : sample_rate(sample_rate ? sample_rate : 44100), frequency(frequency), amplitude(amplitude) {}
+
+size_t beep_synth::frame(const chip8 &c, int16_t *out){
+    // rate/60 samples, plus one whenever the carried remainder reaches a whole sample
+    size_t n = sample_rate / 60;
+    remainder += sample_rate % 60;
+    if(remainder >= 60){
+        remainder -= 60;
+        n++;
+    }
+    if(!c.beeper){
+        for(size_t i=0;i<n;i++)
+            out[i] = 0;
+        phase = 0; // every beep starts on the same edge
+        high = false;
+        return n;
+    }
+    for(size_t i=0;i<n;i++){
+        phase += 2 * frequency;
+        if(phase >= sample_rate){
+            phase -= sample_rate;
+            high = !high;
+        }
+        out[i] = high ? amplitude : -amplitude;
+    }
+    return n;
+}
+
+static void put_le(FILE *f, uint32_t v, int bytes){
+    for(int i=0;i<bytes;i++)
+        fputc((v >> (i*8)) & 0xFF, f);
+}
+
+wav_writer::~wav_writer(){
+    close();
+}
+
+bool wav_writer::open(const std::string &path, uint32_t sample_rate){
+    close();
+    file = fopen(path.c_str(), "wb");
+    if(!file)
+        return false;
+    samples_written = 0;
+    fwrite("RIFF", 1, 4, file);
+    put_le(file, 0, 4); // patched in close()
+    fwrite("WAVEfmt ", 1, 8, file);
+    put_le(file, 16, 4);              // fmt chunk size
+    put_le(file, 1, 2);               // PCM
+    put_le(file, 1, 2);               // mono
+    put_le(file, sample_rate, 4);
+    put_le(file, sample_rate * 2, 4); // byte rate
+    put_le(file, 2, 2);               // block align
+    put_le(file, 16, 2);              // bits per sample
+    fwrite("data", 1, 4, file);
+    put_le(file, 0, 4);               // patched in close()
+    return true;
+}
+
+void wav_writer::write(const int16_t *samples, size_t n){
+    if(!file)
+        return;
+    for(size_t i=0;i<n;i++)
+        put_le(file, (uint16_t)samples[i], 2);
+    samples_written += n;
+}
+
+bool wav_writer::close(){
+    if(!file)
+        return true;
+    uint32_t data = (uint32_t)(samples_written * 2);
+    fseek(file, 4, SEEK_SET);
+    put_le(file, 36 + data, 4);
+    fseek(file, 40, SEEK_SET);
+    put_le(file, data, 4);
+    bool ok = !ferror(file);
+    ok &= fclose(file) == 0;
+    file = nullptr;
+    return ok;
+}
+
+audio_output::audio_output(uint32_t sample_rate, sink out, size_t ring_samples)
+    : sample_rate(sample_rate), out(std::move(out)), ring(ring_samples) {
+    player = std::thread([this]{ run(); });
+}
+
+audio_output::~audio_output(){
+    stop();
+}
+
+void audio_output::push(const int16_t *samples, size_t n){
+    dropped_samples += n - ring.push(samples, n);
+}
+
+void audio_output::stop(){
+    if(!player.joinable())
+        return;
+    stopping.store(true, std::memory_order_release);
+    player.join();
+}
+
+void audio_output::run(){
+    // take a 10ms period's worth of samples at a time, like a device callback would
+    const size_t period = sample_rate / 100 ? sample_rate / 100 : 1;
+    std::vector<int16_t> buffer(period);
+    auto next = std::chrono::steady_clock::now();
+    for(;;){
+        bool last = stopping.load(std::memory_order_acquire);
+        size_t n;
+        while((n = ring.pop(buffer.data(), period)) > 0)
+            out(buffer.data(), n);
+        if(last)
+            return;
+        next += std::chrono::milliseconds(10);
+        std::this_thread::sleep_until(next);
+    }
+}
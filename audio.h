@@ -0,0 +1,77 @@
+#ifndef CHIP8_EMULATOR_AUDIO_H
+#define CHIP8_EMULATOR_AUDIO_H
+
+#include "chip8.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Square wave beep generator. The tone is on for every 60Hz frame that ended with sound_timer
+// non-zero (c.beeper, so ST=N set during a frame sounds for N frames); call frame() after
+// run_frame_chip8. Everything is integer arithmetic on the sample count, so the same run produces
+// the same samples bit for bit whatever the host speed.
+class beep_synth {
+public:
+    explicit beep_synth(uint32_t sample_rate = 44100, uint32_t frequency = 440, int16_t amplitude = 6000);
+
+    uint32_t rate() const { return sample_rate; }
+    // Append one frame worth of mono 16-bit samples (rate/60, spread evenly) to `out`, for the
+    // frame run_frame_chip8 has just run.
+    size_t frame(const chip8 &c, int16_t *out);
+    size_t max_frame_samples() const { return sample_rate / 60 + 1; }
+
+private:
+    uint32_t sample_rate;
+    uint32_t frequency;
+    int16_t amplitude;
+    uint32_t remainder = 0; // sample_rate % 60 carried between frames
+    uint32_t phase = 0;     // position in the half period, in units of 1/(2*frequency) samples
+    bool high = false;
+};
+
+// Mono 16-bit PCM WAV file; the sizes in the header are patched by close().
+class wav_writer {
+public:
+    ~wav_writer();
+    bool open(const std::string &path, uint32_t sample_rate);
+    void write(const int16_t *samples, size_t n);
+    bool close();
+    bool is_open() const { return file != nullptr; }
+
+private:
+    FILE *file = nullptr;
+    uint64_t samples_written = 0;
+};
+
+// Real-time audio path: the emulation thread pushes samples into a lock-free ring and a
+// playback thread drains it to the sink at the sample rate. When the ring is full the
+// newest samples are dropped (and counted) rather than stalling emulation.
+class audio_output {
+public:
+    using sink = std::function<void(const int16_t *, size_t)>;
+
+    audio_output(uint32_t sample_rate, sink out, size_t ring_samples = 8192);
+    ~audio_output();
+
+    void push(const int16_t *samples, size_t n); // emulation thread only
+    uint64_t dropped() const { return dropped_samples; }
+    void stop(); // drain what is queued and join
+
+private:
+    void run();
+
+    uint32_t sample_rate;
+    sink out;
+    spsc_ring<int16_t> ring;
+    uint64_t dropped_samples = 0;
+    std::atomic<bool> stopping{false};
+    std::thread player;
+};
+
+#endif //CHIP8_EMULATOR_AUDIO_H
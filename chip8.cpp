@@ -0,0 +1,705 @@
+#include "chip8.h"
+#ifdef CHIP8_TRACE
+#include "trace.h"
+#endif
+#ifdef CHIP8_PROFILE
+#include "profile.h"
+#endif
+#include "decode.h"
+#ifdef CHIP8_DEBUGGER
+#include "debugger.h"
+#endif
+#ifdef CHIP8_METRICS
+#include "metrics.h"
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// chip 8 font set
+const uint8_t chip8_fontset[80]={
+        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+        0x20, 0x60, 0x20, 0x20, 0x70, // 1
+        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+bool load_rom_chip8(const std::string &path, std::vector<uint8_t> &program){
+    std::ifstream file(path, std::ios::binary); // read program
+    if(!file)
+        return false;
+    program.resize(MAX);
+    file.read((char *)program.data(), MAX);
+    if(!file.eof()) // larger than the program space
+        return false;
+    program.resize(file.gcount()); // get total bytes read
+    return true;
+}
+
+uint64_t rom_hash_chip8(const uint8_t *program, size_t n){
+    // FNV-1a over the bytes, finished with a splitmix round so similar ROMs spread out
+    uint64_t h = 0xCBF29CE484222325ull ^ n;
+    for(size_t i=0;i<n;i++)
+        h = (h ^ program[i]) * 0x100000001B3ull;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+}
+
+void intitialize_chip8(chip8 &c, const uint8_t program[], int n, uint32_t seed){
+    c.PC =  0x200; // PC starts at 0x200
+    c.opcode = 0; // Reset opcode
+    c.I = 0; // Reset index register
+    c.SP = 0; // Reset stack pointer
+
+    memset(c.gfx, 0, sizeof(c.gfx));       // clear display
+    memset(c.stack, 0 , sizeof(c.stack));  // clear stack
+    memset(c.V, 0, sizeof(c.V));           // clear registers
+    memset(c.memory, 0, sizeof(c.memory)); // clear memory
+    memset(c.key, 0, sizeof(c.key));       // release all keys
+
+    // load font set
+     memcpy(c.memory+0x05, chip8_fontset, sizeof(chip8_fontset)); // copy 80 bytes
+
+    // reset timers
+    c.delay_timer = 0;
+    c.sound_timer = 0;
+    c.beeper = 0;
+
+    c.rng = seed ? seed : 1; // xorshift state must never be 0
+
+    // Loading the program into the memory
+    memcpy(c.memory + 0x200, program, n);
+
+    rehash_chip8(c);
+
+    c.trace = nullptr;
+    c.profile = nullptr;
+    c.decoded = nullptr;
+    c.shared = nullptr;
+    c.debug = nullptr;
+    c.metrics = nullptr;
+}
+
+// Zobrist keys for lit pixels, one per screen position.
+struct gfx_key_table {
+    uint64_t k[64 * 32];
+    constexpr gfx_key_table() : k() {
+        uint64_t z = 0x6A09E667F3BCC908ull;
+        for(int i=0;i<64 * 32;i++){
+            z += 0x9E3779B97F4A7C15ull;
+            uint64_t v = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+            k[i] = v ^ (v >> 31);
+        }
+    }
+    constexpr uint64_t operator[](int i) const { return k[i]; }
+};
+static constexpr gfx_key_table gfx_keys;
+
+static uint8_t rand_chip8(chip8 &c){
+    // xorshift32
+    uint32_t r = c.rng;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    c.rng = r;
+    return r >> 24;
+}
+
+
+static inline void draw_chip8(chip8 &c, uint16_t opcode){
+    // XOR an 8xN sprite from memory[I] at (Vx, Vy); VF = 1 if any pixel was turned off.
+    // The start position wraps, pixels past the right/bottom edge are clipped.
+    uint16_t x = (opcode & 0x0F00)>>8;
+    uint16_t y = (opcode & 0x00F0)>>4;
+    uint16_t n = opcode & 0x000F;
+    uint8_t px = c.V[x] % 64;
+    uint8_t py = c.V[y] % 32;
+    uint8_t collision = 0;
+    for(int row=0;row<n && py+row<32;row++){
+        uint8_t sprite = c.memory[(c.I+row) & 0xFFF];
+        for(int col=0;col<8 && px+col<64;col++){
+            if(!(sprite & (0x80>>col)))
+                continue;
+            int p = (py+row)*64 + px+col;
+            collision |= c.gfx[p];
+            c.gfx[p] ^= 1;
+            c.gfx_hash ^= gfx_keys[p];
+        }
+    }
+    c.V[0xF] = collision;
+#ifdef CHIP8_METRICS
+    if(c.metrics) [[unlikely]]
+        c.metrics->draw(c, collision);
+#endif
+}
+
+// Decode and execute one already fetched opcode.
+static inline void execute_chip8(chip8 &c, uint16_t opcode){
+    switch (opcode & 0xF000) {
+        case 0x0000:{
+            switch (opcode){
+                case 0x00E0:{ // clear screen
+                    memset(c.gfx, 0, sizeof(c.gfx));       // clear display
+                    c.gfx_hash = 0; // a blank screen hashes to 0
+                    c.PC += 2;
+                    break;
+                }
+                case 0x00EE:{ //return from subroutine
+                    // restore address from stack and decrement SP
+                    // the stack holds the address of the 2NNN itself, continue after it
+                    c.PC = c.stack[c.SP & 0xF] + 2;
+                    c.SP -= 1;
+                    break;
+                }
+                default:{ // 0NNN: call machine code routine, ignored by modern interpreters
+                    c.PC += 2;
+                }
+            }
+            break;
+        }
+        case 0x1000:{ // 1NNN: goto NNN
+            uint16_t nnn = opcode & 0x0FFF;
+            c.PC = nnn;
+            break;
+        }
+        case 0x2000:{ // 2NNN: Calls subroutine at NNN.
+            uint16_t nnn = opcode & 0x0FFF;
+            c.SP += 1;
+            c.stack[c.SP & 0xF] = c.PC;
+            c.PC = nnn;
+            break;
+        }
+        case 0x3000:{ // 3XNN: Skip next instruction if VX == NN
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint8_t nn = opcode & 0x00FF;
+            c.PC += c.V[x] == nn ? 4 : 2;
+            break;
+        }
+        case 0x4000:{ // 4XNN: Skip next instruction if VX != NN
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint8_t nn = opcode & 0x00FF;
+            c.PC += c.V[x] != nn ? 4 : 2;
+            break;
+        }
+        case 0x5000:{ // 5XY0: Skip next instruction if VX == VY
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint16_t y = (opcode & 0x00F0)>>4;
+            c.PC += c.V[x] == c.V[y] ? 4 : 2;
+            break;
+        }
+        case 0x6000:{ // 6XNN: Sets VX to NN.
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint16_t nn = opcode & 0x00FF;
+            c.V[x] = nn;
+            c.PC += 2;
+            break;
+        }
+        case 0x7000:{ // 7XNN: VX += NN (VF untouched)
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint8_t nn = opcode & 0x00FF;
+            c.V[x] += nn;
+            c.PC += 2;
+            break;
+        }
+        case 0x8000:{ // 8XYN: register to register arithmetic, VF is written last
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint16_t y = (opcode & 0x00F0)>>4;
+            uint8_t vx = c.V[x];
+            uint8_t vy = c.V[y];
+            switch (opcode & 0x000F){
+                case 0x0: c.V[x] = vy; break;          // VX = VY
+                case 0x1: c.V[x] = vx | vy; break;     // VX |= VY
+                case 0x2: c.V[x] = vx & vy; break;     // VX &= VY
+                case 0x3: c.V[x] = vx ^ vy; break;     // VX ^= VY
+                case 0x4:{                             // VX += VY, VF = carry
+                    c.V[x] = vx + vy;
+                    c.V[0xF] = vx + vy > 0xFF;
+                    break;
+                }
+                case 0x5:{                             // VX -= VY, VF = not borrow
+                    c.V[x] = vx - vy;
+                    c.V[0xF] = vx >= vy;
+                    break;
+                }
+                case 0x6:{                             // VX >>= 1, VF = shifted out bit
+                    c.V[x] = vx >> 1;
+                    c.V[0xF] = vx & 1;
+                    break;
+                }
+                case 0x7:{                             // VX = VY - VX, VF = not borrow
+                    c.V[x] = vy - vx;
+                    c.V[0xF] = vy >= vx;
+                    break;
+                }
+                case 0xE:{                             // VX <<= 1, VF = shifted out bit
+                    c.V[x] = vx << 1;
+                    c.V[0xF] = vx >> 7;
+                    break;
+                }
+            }
+            c.PC += 2;
+            break;
+        }
+        case 0x9000:{ // 9XY0: Skip next instruction if VX != VY
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint16_t y = (opcode & 0x00F0)>>4;
+            c.PC += c.V[x] != c.V[y] ? 4 : 2;
+            break;
+        }
+        case 0xA000:{ // ANNN: set I to NNN
+            c.I = opcode & 0x0FFF;
+            c.PC += 2;
+            break;
+        }
+        case 0xB000:{ // BNNN: goto NNN + V0
+            c.PC = ((opcode & 0x0FFF) + c.V[0]) & 0xFFF;
+            break;
+        }
+        case 0xC000:{ // CXNN: Rand Vx = rand() & nn
+            uint16_t x = (opcode & 0x0F00)>>8;
+            uint8_t nn = opcode & 0x00FF;
+            uint8_t r = rand_chip8(c);
+            c.V[x] = r & nn;
+            c.PC += 2;
+            break;
+        }
+        case 0xD000:{ // DXYN:draw(Vx, Vy, N)
+            draw_chip8(c, opcode);
+            c.PC += 2;
+            break;
+        }
+        case 0xE000:{
+            uint16_t x = (opcode & 0x0F00)>>8;
+            switch (opcode & 0x00FF){
+                case 0x9E:{ // EX9E: Skip next instruction if key VX is pressed
+                    c.PC += c.key[c.V[x] & 0xF] ? 4 : 2;
+                    break;
+                }
+                case 0xA1:{ // EXA1: Skip next instruction if key VX is not pressed
+                    c.PC += c.key[c.V[x] & 0xF] ? 2 : 4;
+                    break;
+                }
+                default:{ // unknown, skip it
+                    c.PC += 2;
+                }
+            }
+            break;
+        }
+        case 0xF000:{
+            switch (opcode & 0xF0FF){
+                case 0xF007:{  // VX = delay_timer
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    c.V[x] = c.delay_timer;
+                    c.PC += 2;
+                    break;
+                }
+                case 0xF00A:{  // wait for input
+                    // PC only moves on once a key is down, until then this instruction repeats
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    uint8_t k = 0;
+                    while(k < 16 && !c.key[k])
+                        k++;
+                    if(k < 16){
+                        c.V[x] = k;
+                        c.PC += 2;
+                    }
+#ifdef CHIP8_METRICS
+                    else if(c.metrics) [[unlikely]]
+                        c.metrics->counters[vm_metrics::INPUT_WAITS].add(1);
+#endif
+                    break;
+                }
+                case 0xF015:{  // delay_timer = VX
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    c.delay_timer = c.V[x];
+                    c.PC += 2;
+                    break;
+                }
+                case 0xF018:{  // sound_timer = VX
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    c.sound_timer = c.V[x];
+                    c.PC += 2;
+                    break;
+                }
+                case 0xF01E:{  // I += VX
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    c.I = (c.I + c.V[x]) & 0xFFF;
+                    c.PC += 2;
+                    break;
+                }
+                case 0xF033:{  // set_BCD(Vx) *(I+0) = BCD(3); *(I+1) = BCD(2); *(I+2) = BCD(1);
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    uint16_t n = c.V[x];
+                    store_chip8(c, c.I + 2, n%10);
+                    n /= 10;
+                    store_chip8(c, c.I + 1, n%10);
+                    n /= 10;
+                    store_chip8(c, c.I, n%10);
+                    c.PC += 2;
+                    break;
+                }
+                case 0xF055:{  //reg_dump(Vx, &I) Stores V0 to VX (including VX) in memory starting at address I.
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    for(int i=0;i<=x;i++)
+                        store_chip8(c, c.I+i, c.V[i]);
+                    c.PC += 2;
+                    break;
+                }
+                case 0xF065:{  //reg_load(Vx, &I) Fills V0 to VX (including VX) with values from memory starting at address I.
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    for(int i=0;i<=x;i++)
+                        c.V[i] = c.memory[(c.I+i) & 0xFFF];
+                    c.PC += 2;
+                    break;
+                }
+                case 0xF029:{  //I = sprite_addr[Vx]
+                    uint16_t x = (opcode & 0x0F00)>>8;
+                    c.I = 0x05 + (c.V[x] & 0xF) * 5; // font set is loaded at 0x05, 5 bytes per digit
+                    c.PC += 2;
+                    break;
+                }
+                default:{ // unknown, skip it
+                    c.PC += 2;
+                }
+            }
+            break;
+        }
+
+    }
+}
+
+void emulateCyle_chip8(chip8 &c){
+#ifdef CHIP8_TRACE
+    if(c.trace) [[unlikely]] {
+        trace_cycle_chip8(c); // records and calls back in with the trace detached
+        return;
+    }
+#endif
+#ifdef CHIP8_DEBUGGER
+    if(c.debug) [[unlikely]]
+        debug_cycle_chip8(c); // may stop here and run debugger commands until continue
+#endif
+
+    // Fetch opcode
+    // Big Endian hence, MSB is at lower address
+    uint8_t MSB = c.memory[c.PC & 0xFFF];
+    uint8_t LSB = c.memory[(c.PC+1) & 0xFFF];
+    c.opcode = (MSB<<8) | LSB;
+#ifdef CHIP8_PROFILE
+    if(c.profile) [[unlikely]]
+        c.profile->count(c, c.opcode);
+#endif
+
+    execute_chip8(c, c.opcode);
+}
+
+void tick_timers_chip8(chip8 &c){
+    c.beeper = c.sound_timer > 0; // before the tick, so ST=N sounds for N frames
+    if(c.delay_timer > 0)
+        c.delay_timer--;
+    if(c.sound_timer > 0)
+        c.sound_timer--;
+}
+
+// run_frame_chip8 over c.decoded: opcodes come from the decoded copy and fused sequences run
+// in one dispatch. A sequence only runs fused when the whole of it fits in the frame, so the
+// machine state at every frame boundary matches the plain interpreter.
+static bool run_frame_decoded_chip8(chip8 &c, int cycles, int &i){
+    decoded_op *ops = c.decoded->ops;
+    i = 0;
+    while(i < cycles){
+        uint16_t pc = c.PC;
+        if(c.shared && c.shared->is_dirty(pc)) [[unlikely]] { // about to run code this machine rewrote
+            c.shared->unshare(c);
+            ops = c.decoded->ops;
+        }
+        decoded_op &d = ops[pc & 0xFFF];
+        if(d.fused == FUSED_STALE) [[unlikely]]
+            d = decode_op_chip8(c.memory, pc);
+        if(d.fused == FUSED_NONE || cycles - i < d.length){
+            c.opcode = d.opcode;
+            execute_chip8(c, d.opcode);
+            i++;
+            if(c.PC == pc && (c.opcode & 0xF000) == 0x1000) // jump to itself, the program is over
+                return false;
+            continue;
+        }
+        uint16_t op1 = d.next[0];
+        uint16_t op2 = d.next[1];
+        switch (d.fused) {
+            case FUSED_SET_SET_DRAW:{ // 6XNN; 6YNN; DXYN
+                c.V[(d.opcode & 0x0F00)>>8] = d.opcode & 0x00FF;
+                c.V[(op1 & 0x0F00)>>8] = op1 & 0x00FF;
+                draw_chip8(c, op2);
+                c.opcode = op2;
+                c.PC += 6;
+                i += 3;
+                break;
+            }
+            case FUSED_BCD_LOAD:{ // ANNN; FX33; F265
+                uint8_t v = c.V[(op1 & 0x0F00)>>8];
+                uint8_t digits[3] = {(uint8_t)(v / 100), (uint8_t)(v / 10 % 10), (uint8_t)(v % 10)};
+                c.I = d.opcode & 0x0FFF;
+                for(int k=0;k<3;k++){
+                    store_chip8(c, c.I + k, digits[k]);
+                    c.V[k] = digits[k];
+                }
+                c.opcode = op2;
+                c.PC += 6;
+                i += 3;
+                break;
+            }
+            case FUSED_FONT_DRAW:{ // FX29; DXYN
+                c.I = 0x05 + (c.V[(d.opcode & 0x0F00)>>8] & 0xF) * 5;
+                draw_chip8(c, op1);
+                c.opcode = op1;
+                c.PC += 4;
+                i += 2;
+                break;
+            }
+            case FUSED_COUNT_LOOP:{ // 7XNN; 3YKK; 1NNN, iterated here while it jumps back to itself
+                uint8_t &counter = c.V[(d.opcode & 0x0F00)>>8];
+                const uint8_t &test = c.V[(op1 & 0x0F00)>>8];
+                uint16_t target = op2 & 0x0FFF;
+                int passes = 0;
+                for(;;){
+                    passes++;
+                    counter += d.opcode & 0x00FF;
+                    i += 2;
+                    if(test == (op1 & 0x00FF)){ // skips the jump
+                        c.opcode = op1;
+                        c.PC = pc + 6;
+                        break;
+                    }
+                    i++;
+                    c.opcode = op2;
+                    c.PC = target;
+                    if(target != pc || cycles - i < 3)
+                        break;
+                }
+#ifdef CHIP8_METRICS
+                if(c.metrics) [[unlikely]]
+                    c.metrics->counters[vm_metrics::LOOP_REPEATS].add(passes - 1);
+#endif
+                break;
+            }
+            default: // not a kind this build knows; take it from memory again and retry
+                d = decode_op_chip8(c.memory, pc);
+                break;
+        }
+    }
+    tick_timers_chip8(c);
+    return true;
+}
+
+// One frame on whichever engine fits the attachments; `done` is set to the instructions retired.
+static bool run_cycles_chip8(chip8 &c, int cycles, int &done){
+    // the trace, profiler and debugger observe single instructions, so they always get the interpreter
+    if(c.decoded && !c.trace && !c.profile && !c.debug)
+        return run_frame_decoded_chip8(c, cycles, done);
+    for(done=0;done<cycles;){
+        uint16_t pc = c.PC;
+        emulateCyle_chip8(c);
+        done++;
+        if(c.PC == pc && (c.opcode & 0xF000) == 0x1000) // jump to itself, the program is over
+            return false;
+    }
+    tick_timers_chip8(c);
+    return true;
+}
+
+#ifdef CHIP8_METRICS
+// run_frame_chip8 with c.metrics attached. Kept out of line so the plain frame stays as tight as
+// without metrics compiled in.
+static bool __attribute__((noinline)) metered_frame_chip8(chip8 &c, int cycles, int &done){
+    bool timed = c.metrics->timing_frame();
+    uint64_t start = timed ? metrics_now_ns() : 0;
+    bool running = run_cycles_chip8(c, cycles, done);
+    if(timed)
+        c.metrics->frame_time.record(metrics_now_ns() - start);
+    c.metrics->frame(done);
+    return running;
+}
+#endif
+
+bool run_frame_chip8(chip8 &c, int cycles, int &done){
+#ifdef CHIP8_METRICS
+    if(c.metrics) [[unlikely]]
+        return metered_frame_chip8(c, cycles, done);
+#endif
+    return run_cycles_chip8(c, cycles, done);
+}
+
+bool run_frame_chip8(chip8 &c, int cycles){
+    int done;
+    return run_frame_chip8(c, cycles, done);
+}
+
+void pack_gfx_chip8(const chip8 &c, uint64_t rows[32]){
+    for(int y=0;y<32;y++){
+        const uint8_t *p = c.gfx + y*64;
+        uint64_t row = 0;
+        for(int x=0;x<64;x++)
+            row = row<<1 | (p[x] & 1);
+        rows[y] = row;
+    }
+}
+
+static inline uint64_t mix_chip8(uint64_t h, uint64_t w){
+    // one multiply-xorshift round per 8 bytes
+    h ^= w;
+    h *= 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+void rehash_chip8(chip8 &c){
+    c.mem_hash = 0;
+    for(int i=0;i<0x1000;i++)
+        c.mem_hash ^= mem_key_chip8(i, c.memory[i]);
+    c.gfx_hash = 0;
+    for(int i=0;i<64 * 32;i++)
+        if(c.gfx[i])
+            c.gfx_hash ^= gfx_keys[i];
+}
+
+uint64_t frame_hash_chip8(const chip8 &c){
+    return c.gfx_hash;
+}
+
+uint64_t hash_chip8(const chip8 &c){
+    // memory and screen are already folded into mem_hash/gfx_hash, only the small registers are mixed here
+    uint64_t h = mix_chip8(c.mem_hash, c.gfx_hash);
+    uint64_t w;
+    for(size_t i=0;i<sizeof(c.V);i+=8){
+        memcpy(&w, c.V+i, 8);
+        h = mix_chip8(h, w);
+    }
+    for(size_t i=0;i<sizeof(c.stack);i+=8){
+        memcpy(&w, (const uint8_t *)c.stack+i, 8);
+        h = mix_chip8(h, w);
+    }
+    h = mix_chip8(h, (uint64_t)c.PC | (uint64_t)c.I<<16 | (uint64_t)c.SP<<32 |
+                     (uint64_t)c.delay_timer<<40 | (uint64_t)c.sound_timer<<48);
+    return mix_chip8(h, c.rng);
+}
+
+void save_state_chip8(const chip8 &c, uint8_t out[CHIP8_STATE_BYTES]){
+    uint8_t *p = out;
+    memcpy(p, c.memory, sizeof(c.memory));
+    p += sizeof(c.memory);
+    uint64_t rows[32];
+    pack_gfx_chip8(c, rows);
+    for(int y=0;y<32;y++)
+        for(int b=0;b<8;b++)
+            *p++ = (uint8_t)(rows[y] >> (8*b));
+    memcpy(p, c.V, sizeof(c.V));
+    p += sizeof(c.V);
+    for(int i=0;i<16;i++){
+        *p++ = (uint8_t)c.stack[i];
+        *p++ = (uint8_t)(c.stack[i] >> 8);
+    }
+    for(uint16_t v : {c.PC, c.I, c.opcode}){
+        *p++ = (uint8_t)v;
+        *p++ = (uint8_t)(v >> 8);
+    }
+    *p++ = c.SP;
+    *p++ = c.delay_timer;
+    *p++ = c.sound_timer;
+    for(int b=0;b<4;b++)
+        *p++ = (uint8_t)(c.rng >> (8*b));
+    memcpy(p, c.key, sizeof(c.key));
+}
+
+void load_state_chip8(chip8 &c, const uint8_t in[CHIP8_STATE_BYTES]){
+    const uint8_t *p = in;
+    memcpy(c.memory, p, sizeof(c.memory));
+    p += sizeof(c.memory);
+    for(int y=0;y<32;y++){
+        uint64_t row = 0;
+        for(int b=0;b<8;b++)
+            row |= (uint64_t)*p++ << (8*b);
+        for(int x=0;x<64;x++)
+            c.gfx[y*64 + x] = (row >> (63 - x)) & 1;
+    }
+    memcpy(c.V, p, sizeof(c.V));
+    p += sizeof(c.V);
+    for(int i=0;i<16;i++, p+=2)
+        c.stack[i] = p[0] | p[1]<<8;
+    uint16_t *regs[3] = {&c.PC, &c.I, &c.opcode};
+    for(uint16_t *r : regs){
+        *r = p[0] | p[1]<<8;
+        p += 2;
+    }
+    c.SP = *p++;
+    c.delay_timer = *p++;
+    c.sound_timer = *p++;
+    c.beeper = 0; // set again by the next frame's tick
+    c.rng = p[0] | p[1]<<8 | p[2]<<16 | (uint32_t)p[3]<<24;
+    p += 4;
+    memcpy(c.key, p, sizeof(c.key));
+    rehash_chip8(c);
+
+    c.trace = nullptr;
+    c.profile = nullptr;
+    c.decoded = nullptr;
+    c.shared = nullptr;
+    c.debug = nullptr;
+    c.metrics = nullptr;
+}
+
+std::string diff_state_chip8(const chip8 &a, const chip8 &b){
+    char buf[48];
+    auto reg = [](const std::string &name, unsigned x, unsigned y){
+        char values[32];
+        snprintf(values, sizeof(values), " 0x%X != 0x%X", x, y);
+        return name + values;
+    };
+    if(a.PC != b.PC)
+        return reg("PC", a.PC, b.PC);
+    for(int i=0;i<16;i++)
+        if(a.V[i] != b.V[i]){
+            snprintf(buf, sizeof(buf), "V%X", i);
+            return reg(buf, a.V[i], b.V[i]);
+        }
+    if(a.I != b.I)
+        return reg("I", a.I, b.I);
+    if(a.SP != b.SP)
+        return reg("SP", a.SP, b.SP);
+    for(int i=0;i<16;i++)
+        if(a.stack[i] != b.stack[i]){
+            snprintf(buf, sizeof(buf), "stack[%d]", i);
+            return reg(buf, a.stack[i], b.stack[i]);
+        }
+    if(a.delay_timer != b.delay_timer)
+        return reg("delay_timer", a.delay_timer, b.delay_timer);
+    if(a.sound_timer != b.sound_timer)
+        return reg("sound_timer", a.sound_timer, b.sound_timer);
+    if(a.rng != b.rng)
+        return reg("rng", a.rng, b.rng);
+    for(int i=0;i<0x1000;i++)
+        if(a.memory[i] != b.memory[i]){
+            snprintf(buf, sizeof(buf), "memory[0x%03X]", i);
+            return reg(buf, a.memory[i], b.memory[i]);
+        }
+    for(int i=0;i<64 * 32;i++)
+        if(a.gfx[i] != b.gfx[i]){
+            snprintf(buf, sizeof(buf), "pixel (%d, %d) %d != %d", i % 64, i / 64, a.gfx[i], b.gfx[i]);
+            return buf;
+        }
+    return "";
+}
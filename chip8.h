@@ -0,0 +1,204 @@
+#ifndef CHIP8_EMULATOR_CHIP8_H
+#define CHIP8_EMULATOR_CHIP8_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Link to Chip 8 refrence : http://devernay.free.fr/hacks/chip8/C8TECH10.HTM
+Chip 8 Memory Map (total memory 4kb):
+
+|-----8-Bits----|
+
++---------------+= 0xFFF (4095) End of Chip-8 RAM
+|               |
+|               |
+|               |
+|               |
+|               |
+| 0x200 to 0xFFF|
+|     Chip-8    |
+| Program / Data|
+|     Space     |
+|               |
+|               |
+|               |
++- - - - - - - -+= 0x600 (1536) Start of ETI 660 Chip-8 programs
+|               |
+|               |
+|               |
++---------------+= 0x200 (512) Start of most Chip-8 programs
+| 0x000 to 0x1FF|
+| Reserved for  |
+|  interpreter  |
++---------------+= 0x000 (0) Start of Chip-8 RAM
+
+    - 0x000-0x1FF - Chip 8 interpreter (contains font set in emu) [First 512 bytes are reserved]
+    - 0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F) [Part of reserved (80) bytes for font set]
+    - 0x200-0xFFF - Program ROM and work RAM [Part of Ram that can be used by programs]
+
+ Registers:
+    -  There are total 16 (8 bit) registers named as V0,V1,...Vf
+    -  There is also special 16 bit I register which stores address lower 12 bits(0x000-0x1ff)
+    -  Vf register is not used by program, it used as flag register
+    - Program Counter (PC) should be 16 bit (points to address of next instruction to be executed)
+    - Stack pointer should be 8 bit (points to top of the stack)
+    - Stack is an array of 16 16bit value, address to return to after the subroutine has finished
+
+Instructions
+    - Chip-8 language includes 36 different instructions
+    - All instructions are 2 bytes long and are stored most-significant-byte first
+    - In memory, the first byte of each instruction should be located at an even addresses.
+    - If a program includes sprite data, it should be padded so any instructions following it will be properly situated in RAM.
+
+Graphics
+    - The graphics system: The chip 8 has one instruction that draws sprite to the screen. Drawing is done in XOR mode and
+        if a pixel is turned off as a result of drawing, the VF register is set. This is used for collision detection.
+    - The graphics of the Chip 8 are black and white and the screen has a total of 2048 pixels (64 x 32).
+        This can easily be implemented using an array that hold the pixel state (1 or 0):
+ */
+
+class trace_ring;
+class guest_profiler;
+struct decoded_program;
+class shared_decoded;
+class debugger;
+class vm_metrics;
+
+#define MAX 3584 // largest program that fits in 0x200-0xFFF
+
+// Complete state of one chip 8 machine. Everything an instruction can read or write lives here,
+// so several machines can run side by side (one per thread) and a machine can be copied to fork it.
+// Laid out by how often the interpreter touches each part:
+//   line 0   registers, timers, rng and the attachment pointers, read or written every instruction
+//   line 1   stack, keys, the debugger (only attached while it has something to check) and the
+//            metrics, counted per frame and per draw
+//   line 2   the incremental hashes, touched by stores and draws, and the beeper, once per frame
+//   memory, gfx   each starts on its own line
+// The struct is aligned to and padded out to whole cache lines, so machines next to each
+// other in an array (chip8_env, explore) never share a line even when different threads run them.
+#define CHIP8_CACHE_LINE 64
+
+#ifdef CHIP8_NAIVE_LAYOUT
+// The fields in the order of the original globals, with no alignment or padding: hot registers
+// spread around memory and neighbouring machines sharing lines. Only built into
+// Chip8_layout_naive, to measure what the layout below saves.
+struct chip8 {
+    uint16_t opcode ; // store op code
+    uint8_t memory[0x1000]; // 4KB memory
+    uint8_t V[16]; // 16 8 bit genral purpose register
+
+    uint16_t PC ; // 16 bit PC register
+    uint8_t SP ; // 16 bit SP register [SP always points to last address to pop]
+    uint16_t I ; // 16 bit index register I
+    uint16_t stack[16]; // 16 level stack
+
+    uint8_t gfx[64 * 32] ; // black & white screen
+
+    uint8_t delay_timer; // timer register
+    uint8_t sound_timer; // timer register
+
+    uint8_t key[16]; //  array to store the current state of the key
+
+    uint32_t rng; // CXNN random generator state (per machine so runs are reproducible)
+
+    uint64_t mem_hash;
+    uint64_t gfx_hash;
+    uint8_t beeper;
+
+    trace_ring *trace;
+    guest_profiler *profile;
+    decoded_program *decoded;
+    shared_decoded *shared;
+    debugger *debug;
+    vm_metrics *metrics;
+};
+#else
+struct alignas(CHIP8_CACHE_LINE) chip8 {
+    uint8_t V[16]; // 16 8 bit genral purpose register
+    uint16_t PC ; // 16 bit PC register
+    uint16_t I ; // 16 bit index register I
+    uint16_t opcode ; // store op code
+    uint8_t SP ; // 16 bit SP register [SP always points to last address to pop]
+    uint8_t delay_timer; // timer register
+    uint8_t sound_timer; // timer register
+    uint32_t rng; // CXNN random generator state (per machine so runs are reproducible)
+
+    // Optional attachments, not part of the machine state. intitialize_chip8 detaches them.
+    trace_ring *trace; // execution trace (trace.h), nullptr = off
+    guest_profiler *profile; // hot-spot profiler (profile.h), nullptr = off
+    decoded_program *decoded; // pre-decoded program with fused handlers (decode.h), nullptr = plain interpreter
+    shared_decoded *shared; // set while `decoded` is shared with other machines (decode.h), nullptr = private
+
+    alignas(CHIP8_CACHE_LINE) uint16_t stack[16]; // 16 level stack
+    uint8_t key[16]; //  array to store the current state of the key
+    debugger *debug; // breakpoints and watchpoints (debugger.h), nullptr = off
+    vm_metrics *metrics; // counters and latency histograms (metrics.h), nullptr = off
+
+    // Zobrist style hashes kept up to date by every write to memory and every pixel flip,
+    // so the hash of the whole machine costs O(1). Code that writes memory/gfx directly
+    // instead of through store_chip8 / the emulator must call rehash_chip8 afterwards.
+    alignas(CHIP8_CACHE_LINE) uint64_t mem_hash;
+    uint64_t gfx_hash;
+    uint8_t beeper; // the sound timer was running at the last timer tick: the tone sounded that frame
+
+    alignas(CHIP8_CACHE_LINE) uint8_t memory[0x1000]; // 4KB memory
+    alignas(CHIP8_CACHE_LINE) uint8_t gfx[64 * 32] ; // black & white screen
+};
+
+static_assert(offsetof(chip8, shared) + sizeof(shared_decoded *) <= CHIP8_CACHE_LINE, "hot state must fit one line");
+static_assert(offsetof(chip8, metrics) + sizeof(vm_metrics *) <= 2 * CHIP8_CACHE_LINE, "warm state must fit the second line");
+static_assert(offsetof(chip8, memory) % CHIP8_CACHE_LINE == 0 && offsetof(chip8, gfx) % CHIP8_CACHE_LINE == 0,
+              "memory and gfx start on their own lines");
+static_assert(sizeof(chip8) % CHIP8_CACHE_LINE == 0, "neighbouring machines must not share a line");
+#endif
+
+extern const uint8_t chip8_fontset[80];
+
+bool load_rom_chip8(const std::string &path, std::vector<uint8_t> &program); // read a .ch8 file
+uint64_t rom_hash_chip8(const uint8_t *program, size_t n); // content hash, names ROMs in caches and bundles
+void intitialize_chip8(chip8 &c, const uint8_t program[], int n, uint32_t seed = 1);
+void emulateCyle_chip8(chip8 &c);
+void tick_timers_chip8(chip8 &c); // 60Hz delay/sound timer decrement
+bool run_frame_chip8(chip8 &c, int cycles); // one 60Hz frame; false once the program jumps to itself
+bool run_frame_chip8(chip8 &c, int cycles, int &done); // and `done` set to the instructions it retired
+void invalidate_decoded_chip8(chip8 &c, uint16_t addr); // memory[addr] changed under c.decoded
+
+// Zobrist key of `value` stored at `addr`. Computed (splitmix64) rather than looked up,
+// a 4096 x 256 table would be 8MB. A zero byte has key 0 so cleared memory hashes to 0.
+inline uint64_t mem_key_chip8(uint16_t addr, uint8_t value){
+    if(value == 0)
+        return 0;
+    uint64_t z = ((uint64_t)addr<<8 | value) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Write one byte of guest memory, keeping mem_hash current.
+inline void store_chip8(chip8 &c, uint16_t addr, uint8_t value){
+    addr &= 0xFFF;
+    c.mem_hash ^= mem_key_chip8(addr, c.memory[addr]) ^ mem_key_chip8(addr, value);
+    if(c.decoded && c.memory[addr] != value) [[unlikely]]
+        invalidate_decoded_chip8(c, addr);
+    c.memory[addr] = value;
+}
+
+// Screen as 32 rows of 64 bits, bit 63 is the leftmost pixel (same order as sprite bytes).
+void pack_gfx_chip8(const chip8 &c, uint64_t rows[32]);
+
+uint64_t hash_chip8(const chip8 &c); // hash of memory, registers, stack and screen, O(1)
+uint64_t frame_hash_chip8(const chip8 &c); // hash of the screen only, O(1)
+void rehash_chip8(chip8 &c); // recompute mem_hash and gfx_hash from scratch
+
+// Machine state as a flat little endian byte string: memory, packed screen, registers, stack,
+// timers, rng and keys. load_state_chip8 detaches every attachment, like intitialize_chip8.
+#define CHIP8_STATE_BYTES (0x1000 + 32 * 8 + 16 + 16 * 2 + 2 + 2 + 2 + 1 + 1 + 1 + 4 + 16)
+void save_state_chip8(const chip8 &c, uint8_t out[CHIP8_STATE_BYTES]);
+void load_state_chip8(chip8 &c, const uint8_t in[CHIP8_STATE_BYTES]);
+// First difference between two machines as text ("PC 0x204 != 0x206", "memory[0x3A0] ..."), empty if equal.
+std::string diff_state_chip8(const chip8 &a, const chip8 &b);
+
+#endif //CHIP8_EMULATOR_CHIP8_H
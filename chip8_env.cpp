@@ -0,0 +1,214 @@
+#include "chip8_env.h"
+#include "chip8.h"
+#include "decode.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Workers that all run the same job over their own slice of the batch.
+// Unlike thread_pool nothing is queued, so a step does not allocate.
+class batch_workers {
+public:
+    batch_workers(unsigned threads, std::function<void(unsigned)> job) : job(std::move(job)) {
+        for(unsigned t=1;t<threads;t++) // the calling thread is worker 0
+            workers.emplace_back([this, t]{ work(t); });
+    }
+
+    ~batch_workers(){
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        start.notify_all();
+        for(auto &t : workers)
+            t.join();
+    }
+
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    void run(){
+        {
+            std::lock_guard<std::mutex> lock(m);
+            generation++;
+            running = (unsigned)workers.size();
+        }
+        start.notify_all();
+        job(0);
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [this]{ return running == 0; });
+    }
+
+private:
+    void work(unsigned t){
+        uint64_t seen = 0;
+        for(;;){
+            {
+                std::unique_lock<std::mutex> lock(m);
+                start.wait(lock, [&]{ return stopping || generation != seen; });
+                if(stopping)
+                    return;
+                seen = generation;
+            }
+            job(t);
+            std::lock_guard<std::mutex> lock(m);
+            if(--running == 0)
+                done.notify_one();
+        }
+    }
+
+    std::function<void(unsigned)> job;
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable start;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    unsigned running = 0;
+    bool stopping = false;
+};
+
+} // namespace
+
+struct chip8_env {
+    std::vector<uint8_t> rom;
+    std::vector<uint16_t> taps;
+    int cycles_per_frame;
+    uint32_t max_frames;
+    uint32_t seed;
+    bool auto_reset;
+
+    std::vector<chip8> machines;
+    std::shared_ptr<const decoded_program> program; // decoded once, run by every machine
+    std::vector<shared_decoded> decoded;
+    std::vector<uint32_t> frame; // steps since reset
+    std::vector<uint8_t> halted;
+
+    // arguments of the step in progress, read by the workers
+    const uint16_t *actions = nullptr;
+    uint8_t *frames_out = nullptr;
+    uint8_t *taps_out = nullptr;
+    uint8_t *done_out = nullptr;
+    bool resetting = false;
+
+    batch_workers *workers = nullptr;
+
+    void reset_one(int i){
+        intitialize_chip8(machines[i], rom.data(), (int)rom.size(), seed + i);
+        decoded[i].attach(machines[i], program);
+        frame[i] = 0;
+        halted[i] = 0;
+    }
+
+    void write_outputs(int i){
+        const chip8 &c = machines[i];
+        if(frames_out)
+            memcpy(frames_out + (size_t)i * sizeof(c.gfx), c.gfx, sizeof(c.gfx));
+        if(taps_out)
+            for(size_t t=0;t<taps.size();t++)
+                taps_out[(size_t)i * taps.size() + t] = c.memory[taps[t] & 0xFFF];
+        if(done_out)
+            done_out[i] = halted[i] || (max_frames && frame[i] >= max_frames);
+    }
+
+    void step_one(int i){
+        chip8 &c = machines[i];
+        if(auto_reset && (halted[i] || (max_frames && frame[i] >= max_frames)))
+            reset_one(i);
+        uint16_t keys = actions ? actions[i] : 0;
+        for(int k=0;k<16;k++)
+            c.key[k] = (keys >> k) & 1;
+        if(!halted[i]){
+            halted[i] = !run_frame_chip8(c, cycles_per_frame);
+            frame[i]++;
+        }
+        write_outputs(i);
+    }
+
+    void slice(unsigned t){
+        int n = (int)machines.size();
+        int threads = (int)workers->size();
+        int begin = (int)((int64_t)n * t / threads);
+        int end = (int)((int64_t)n * (t + 1) / threads);
+        for(int i=begin;i<end;i++){
+            if(resetting){
+                reset_one(i);
+                write_outputs(i);
+            }
+            else
+                step_one(i);
+        }
+    }
+};
+
+extern "C" {
+
+chip8_env *chip8_env_create(const uint8_t *rom, size_t rom_size, int count, const chip8_env_config *config){
+    if(!rom || rom_size > MAX || count <= 0)
+        return nullptr;
+    chip8_env_config defaults = {};
+    if(!config)
+        config = &defaults;
+
+    chip8_env *env = new chip8_env;
+    env->rom.assign(rom, rom + rom_size);
+    if(config->ram_taps && config->n_taps > 0)
+        env->taps.assign(config->ram_taps, config->ram_taps + config->n_taps);
+    env->cycles_per_frame = config->cycles_per_frame > 0 ? config->cycles_per_frame : 10;
+    env->max_frames = config->max_frames;
+    env->seed = config->seed;
+    env->auto_reset = config->auto_reset != 0;
+    env->machines.resize(count);
+    env->decoded.resize(count);
+    auto scratch = std::make_unique<chip8>();
+    intitialize_chip8(*scratch, rom, (int)rom_size);
+    env->program = shared_program_chip8(*scratch, rom, rom_size);
+    env->frame.resize(count);
+    env->halted.resize(count);
+
+    unsigned threads = config->threads > 0 ? config->threads : std::thread::hardware_concurrency();
+    if(threads == 0)
+        threads = 1;
+    if(threads > (unsigned)count)
+        threads = count;
+    env->workers = new batch_workers(threads, [env](unsigned t){ env->slice(t); });
+
+    chip8_env_reset(env, nullptr);
+    return env;
+}
+
+void chip8_env_destroy(chip8_env *env){
+    if(!env)
+        return;
+    delete env->workers;
+    delete env;
+}
+
+int chip8_env_count(const chip8_env *env){
+    return (int)env->machines.size();
+}
+
+void chip8_env_reset(chip8_env *env, uint8_t *frames){
+    env->resetting = true;
+    env->actions = nullptr;
+    env->frames_out = frames;
+    env->taps_out = nullptr;
+    env->done_out = nullptr;
+    env->workers->run();
+    env->resetting = false;
+}
+
+void chip8_env_step(chip8_env *env, const uint16_t *actions, uint8_t *frames, uint8_t *taps, uint8_t *done){
+    env->actions = actions;
+    env->frames_out = frames;
+    env->taps_out = taps;
+    env->done_out = done;
+    env->workers->run();
+}
+
+}
@@ -0,0 +1,57 @@
+#ifndef CHIP8_EMULATOR_CHIP8_ENV_H
+#define CHIP8_EMULATOR_CHIP8_ENV_H
+
+/*
+ * C ABI for driving a batch of chip 8 machines from training code (libchip8env).
+ *
+ * All machines run the same ROM. Every call to chip8_env_step advances every machine by one
+ * 60Hz frame, spread over the batch's worker threads, and writes its results into buffers
+ * owned by the caller, so stepping never allocates.
+ *
+ *   frames : count * 64 * 32 bytes, one byte (0 or 1) per pixel, row major
+ *   taps   : count * n_taps bytes, memory[ram_taps[t]] of every machine after the frame
+ *   done   : count bytes, 1 if the machine halted (jump to itself) or reached max_frames
+ *
+ * Any output pointer may be NULL to skip that output.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define CHIP8_ENV_API __declspec(dllexport)
+#else
+#define CHIP8_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct chip8_env chip8_env;
+
+typedef struct chip8_env_config {
+    int cycles_per_frame;     // instructions per step, 0 = 10
+    int threads;              // worker threads, 0 = one per core
+    const uint16_t *ram_taps; // memory addresses copied out after every step (copied at create)
+    int n_taps;
+    uint32_t max_frames;      // a machine is done after this many steps, 0 = never
+    uint32_t seed;            // machine i gets seed + i for CXNN
+    int auto_reset;           // reset machines that are done at the start of the next step
+} chip8_env_config;
+
+CHIP8_ENV_API chip8_env *chip8_env_create(const uint8_t *rom, size_t rom_size, int count, const chip8_env_config *config);
+CHIP8_ENV_API void chip8_env_destroy(chip8_env *env);
+CHIP8_ENV_API int chip8_env_count(const chip8_env *env);
+
+// Reset every machine and write the initial frames (may be NULL).
+CHIP8_ENV_API void chip8_env_reset(chip8_env *env, uint8_t *frames);
+
+// actions[i] is the keypad of machine i for this frame, bit k set = key k held.
+CHIP8_ENV_API void chip8_env_step(chip8_env *env, const uint16_t *actions, uint8_t *frames, uint8_t *taps, uint8_t *done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CHIP8_EMULATOR_CHIP8_ENV_H
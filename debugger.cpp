@@ -0,0 +1,277 @@
+#include "debugger.h"
+#include "disasm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <poll.h>
+#include <unistd.h>
+
+static const char *const HELP =
+    "  b ADDR            break when PC reaches ADDR        d ADDR            delete breakpoint\n"
+    "  w ADDR [LEN] [r|w|rw]  watch memory (default w)     dw ADDR [LEN]     delete watchpoint\n"
+    "  c                 continue                          s [N]             step N instructions\n"
+    "  p                 pause the running machine         l                 list breakpoints/watchpoints\n"
+    "  r                 registers                         x ADDR [LEN]      dump memory\n"
+    "  u [ADDR] [N]      disassemble (default at PC)       bt                call stack\n"
+    "  q                 quit the emulator                 help\n";
+
+debugger::debugger(int fd) : fd(fd) {
+    reader = std::thread([this]{
+        std::string partial;
+        char buf[256];
+        for(;;){
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if(input_closed)
+                    return;
+            }
+            pollfd p = {this->fd, POLLIN, 0};
+            if(::poll(&p, 1, 100) <= 0)
+                continue; // timeout, check for shutdown
+            ssize_t n = read(this->fd, buf, sizeof(buf));
+            std::lock_guard<std::mutex> lock(m);
+            if(n <= 0){
+                input_closed = true;
+                ready.notify_all();
+                return;
+            }
+            partial.append(buf, n);
+            size_t eol;
+            while((eol = partial.find('\n')) != std::string::npos){
+                lines.push_back(partial.substr(0, eol));
+                partial.erase(0, eol + 1);
+            }
+            ready.notify_all();
+        }
+    });
+}
+
+debugger::~debugger(){
+    {
+        std::lock_guard<std::mutex> lock(m);
+        input_closed = true;
+    }
+    reader.join();
+}
+
+bool debugger::next_line(std::string &line, bool wait){
+    std::unique_lock<std::mutex> lock(m);
+    if(wait)
+        ready.wait(lock, [this]{ return !lines.empty() || input_closed; });
+    if(lines.empty())
+        return false;
+    line = std::move(lines.front());
+    lines.pop_front();
+    return true;
+}
+
+void debugger::sync(chip8 &c){
+    std::string line;
+    // commands typed ahead of a step wait for the stop it ends in
+    while(!step_count && next_line(line, false)){
+        std::string out = command(c, line);
+        fputs(out.c_str(), stderr);
+    }
+    c.debug = wants_attach() ? this : nullptr;
+}
+
+void debugger::set(uint16_t addr, uint16_t len, uint8_t f, bool on){
+    for(uint32_t a=addr;a<(uint32_t)addr + len;a++){
+        uint8_t &fl = flags[a & 0xFFF];
+        bool watched = fl & (WATCH_READ | WATCH_WRITE);
+        bool breaks = fl & BREAK;
+        fl = on ? (fl | f) : (fl & ~f);
+        breakpoints += (bool)(fl & BREAK) - breaks;
+        watchpoints += (bool)(fl & (WATCH_READ | WATCH_WRITE)) - watched;
+    }
+}
+
+static std::string registers(const chip8 &c){
+    char buf[256];
+    char text[32];
+    disassemble_chip8(c.memory[c.PC & 0xFFF]<<8 | c.memory[(c.PC+1) & 0xFFF], text, sizeof(text));
+    int n = snprintf(buf, sizeof(buf), "PC %03X  I %03X  SP %X  DT %02X  ST %02X   next: %s\n ",
+                     c.PC, c.I, c.SP & 0xF, c.delay_timer, c.sound_timer, text);
+    for(int i=0;i<16;i++)
+        n += snprintf(buf + n, sizeof(buf) - n, " V%X=%02X", i, c.V[i]);
+    snprintf(buf + n, sizeof(buf) - n, "\n");
+    return buf;
+}
+
+std::string debugger::command(chip8 &c, const std::string &line){
+    std::istringstream in(line);
+    std::string cmd, a1, a2, a3;
+    in >> cmd >> a1 >> a2 >> a3;
+    auto num = [](const std::string &s, unsigned def){
+        return s.empty() ? def : (unsigned)std::strtoul(s.c_str(), nullptr, 16); // addresses are hex
+    };
+    char buf[128];
+    std::string out;
+
+    if(cmd.empty())
+        return "";
+    if(cmd == "b" || cmd == "d"){
+        set(num(a1, c.PC) & 0xFFF, 1, BREAK, cmd == "b");
+        snprintf(buf, sizeof(buf), "%s breakpoint at %03X\n", cmd == "b" ? "set" : "deleted", num(a1, c.PC) & 0xFFF);
+        return buf;
+    }
+    if(cmd == "w" || cmd == "dw"){
+        // LEN and the mode may come in either order after the address
+        std::string mode = cmd == "w" ? "w" : "rw";
+        unsigned len = 1;
+        for(const std::string &arg : {a2, a3}){
+            if(arg == "r" || arg == "w" || arg == "rw")
+                mode = arg;
+            else if(!arg.empty())
+                len = num(arg, 1);
+        }
+        unsigned addr = num(a1, c.I) & 0xFFF;
+        uint8_t f = (mode.find('r') != std::string::npos ? WATCH_READ : 0) | (mode.find('w') != std::string::npos ? WATCH_WRITE : 0);
+        set(addr, len, f, cmd == "w");
+        snprintf(buf, sizeof(buf), "%s %s watchpoint on %03X..%03X\n", cmd == "w" ? "set" : "deleted", mode.c_str(),
+                 addr, (addr + len - 1) & 0xFFF);
+        return buf;
+    }
+    if(cmd == "l"){
+        for(int a=0;a<0x1000;a++){
+            if(!flags[a])
+                continue;
+            snprintf(buf, sizeof(buf), "  %03X%s%s%s\n", a, flags[a] & BREAK ? " break" : "",
+                     flags[a] & WATCH_READ ? " read" : "", flags[a] & WATCH_WRITE ? " write" : "");
+            out += buf;
+        }
+        return out.empty() ? "no breakpoints or watchpoints\n" : out;
+    }
+    if(cmd == "r")
+        return registers(c);
+    if(cmd == "x"){
+        unsigned addr = num(a1, c.I), len = num(a2, 0x10);
+        for(unsigned i=0;i<len;i++){
+            if(i % 16 == 0){
+                snprintf(buf, sizeof(buf), "%s%03X:", i ? "\n" : "", (addr + i) & 0xFFF);
+                out += buf;
+            }
+            snprintf(buf, sizeof(buf), " %02X", c.memory[(addr + i) & 0xFFF]);
+            out += buf;
+        }
+        return out + "\n";
+    }
+    if(cmd == "u"){
+        unsigned addr = num(a1, c.PC), count = num(a2, 8);
+        for(unsigned i=0;i<count;i++, addr+=2){
+            uint16_t op = c.memory[addr & 0xFFF]<<8 | c.memory[(addr+1) & 0xFFF];
+            char text[32];
+            disassemble_chip8(op, text, sizeof(text));
+            snprintf(buf, sizeof(buf), "%s %03X  %04X  %s\n", (addr & 0xFFF) == (c.PC & 0xFFF) ? ">" : " ", addr & 0xFFF, op, text);
+            out += buf;
+        }
+        return out;
+    }
+    if(cmd == "bt"){
+        for(int i=c.SP & 0xF;i>0;i--){
+            snprintf(buf, sizeof(buf), "  #%d called from %03X\n", (c.SP & 0xF) - i, c.stack[i]);
+            out += buf;
+        }
+        return out.empty() ? "  (top level)\n" : out;
+    }
+    if(cmd == "c"){
+        resume = true;
+        return "";
+    }
+    if(cmd == "s"){
+        step_count = a1.empty() ? 1 : std::strtoull(a1.c_str(), nullptr, 10); // a count, not an address
+        if(!step_count)
+            step_count = 1;
+        resume = true;
+        return "";
+    }
+    if(cmd == "p"){
+        stop_requested = true;
+        return "";
+    }
+    if(cmd == "q"){
+        quitting = true;
+        resume = true;
+        return "";
+    }
+    if(cmd == "help")
+        return HELP;
+    return "unknown command \"" + cmd + "\", try help\n";
+}
+
+void debugger::stop(chip8 &c, const std::string &why){
+    fprintf(stderr, "%s\n%s", why.c_str(), registers(c).c_str());
+    resume = false;
+    stop_requested = false;
+    step_count = 0;
+    std::string line;
+    while(!resume){
+        fputs("(chip8) ", stderr);
+        if(!next_line(line, true)){
+            // nobody left to answer: drop every breakpoint so the machine runs on detached
+            fputs("\ninput closed, detaching\n", stderr);
+            memset(flags, 0, sizeof(flags));
+            breakpoints = watchpoints = 0;
+            break;
+        }
+        fputs(command(c, line).c_str(), stderr);
+    }
+    stop_requested = false; // "p" while already stopped
+}
+
+void debugger::check(chip8 &c){
+    if(quitting)
+        return; // the frame loop ends at the next sync
+    uint16_t pc = c.PC & 0xFFF;
+    char why[96];
+    if(step_count && --step_count == 0){
+        snprintf(why, sizeof(why), "stepped to %03X", pc);
+        return stop(c, why);
+    }
+    if(stop_requested){
+        snprintf(why, sizeof(why), "paused at %03X", pc);
+        return stop(c, why);
+    }
+    if(flags[pc] & BREAK){
+        snprintf(why, sizeof(why), "breakpoint at %03X", pc);
+        return stop(c, why);
+    }
+    if(!watchpoints)
+        return;
+
+    // memory the next instruction reads or writes through I
+    uint16_t opcode = c.memory[pc]<<8 | c.memory[(pc+1) & 0xFFF];
+    uint16_t len = 0;
+    uint8_t kind = 0;
+    if((opcode & 0xF000) == 0xD000){
+        len = opcode & 0xF;
+        kind = WATCH_READ;
+    }
+    else if((opcode & 0xF0FF) == 0xF033){
+        len = 3;
+        kind = WATCH_WRITE;
+    }
+    else if((opcode & 0xF0FF) == 0xF055){
+        len = ((opcode >> 8) & 0xF) + 1;
+        kind = WATCH_WRITE;
+    }
+    else if((opcode & 0xF0FF) == 0xF065){
+        len = ((opcode >> 8) & 0xF) + 1;
+        kind = WATCH_READ;
+    }
+    for(uint16_t i=0;i<len;i++){
+        uint16_t addr = (c.I + i) & 0xFFF;
+        if(flags[addr] & kind){
+            snprintf(why, sizeof(why), "watchpoint: %s %03X at %03X (%04X)", kind == WATCH_READ ? "read of" : "write to",
+                     addr, pc, opcode);
+            return stop(c, why);
+        }
+    }
+}
+
+void debug_cycle_chip8(chip8 &c){
+    c.debug->check(c);
+}
@@ -0,0 +1,66 @@
+#ifndef CHIP8_EMULATOR_DEBUGGER_H
+#define CHIP8_EMULATOR_DEBUGGER_H
+
+#include "chip8.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Interactive debugger: PC breakpoints, memory read/write watchpoints, step/continue and
+// inspection, driven by text commands read from a file descriptor (stdin by default).
+//
+// Every address has a flag byte (break / watch read / watch write). The flags are only looked
+// at from debug_cycle_chip8, i.e. while the debugger is attached to the machine, and sync()
+// attaches it only while there is something to check: with no breakpoints or watchpoints the
+// machine runs detached, fused and at full speed, and the debugger costs one pointer test per
+// frame. Watchpoints stop before the instruction that would touch the address (DXYN, FX33,
+// FX55, FX65; instruction fetches are not watched).
+//
+// Commands arrive on a reader thread. While the machine runs they are executed at the next
+// frame boundary by sync(); once it is stopped they are executed right away, between two
+// instructions, until "continue" or "step". Output goes to stderr so it does not mix with
+// the terminal renderer. "help" lists the commands.
+class debugger {
+public:
+    enum flag : uint8_t { BREAK = 1, WATCH_READ = 2, WATCH_WRITE = 4 };
+
+    explicit debugger(int fd = 0); // starts the command reader
+    ~debugger();
+    debugger(const debugger &) = delete;
+    debugger &operator=(const debugger &) = delete;
+
+    void sync(chip8 &c);     // once per frame: run queued commands, attach or detach
+    void check(chip8 &c);    // before every instruction while attached
+    bool quit() const { return quitting; }
+
+    std::string command(chip8 &c, const std::string &line); // one command, returns its output
+
+private:
+    bool wants_attach() const { return breakpoints || watchpoints || stop_requested || step_count; }
+    void stop(chip8 &c, const std::string &why); // command loop until continue/step/quit
+    bool next_line(std::string &line, bool wait);
+    void set(uint16_t addr, uint16_t len, uint8_t f, bool on);
+
+    uint8_t flags[0x1000] = {};
+    int breakpoints = 0;     // addresses with BREAK
+    int watchpoints = 0;     // addresses with WATCH_READ or WATCH_WRITE
+    uint64_t step_count = 0; // instructions left to step, 0 = not stepping
+    bool stop_requested = false;
+    bool resume = false;     // set by continue/step inside stop()
+    bool quitting = false;
+
+    int fd;
+    std::thread reader;
+    std::mutex m;
+    std::condition_variable ready;
+    std::deque<std::string> lines;
+    bool input_closed = false;
+};
+
+void debug_cycle_chip8(chip8 &c); // emulateCyle_chip8 hook with c.debug attached
+
+#endif //CHIP8_EMULATOR_DEBUGGER_H
@@ -0,0 +1,141 @@
+#include "decode.h"
+#ifdef CHIP8_METRICS
+#include "metrics.h"
+#endif
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+static uint16_t fetch(const uint8_t *memory, uint16_t addr){
+    return memory[addr & 0xFFF]<<8 | memory[(addr+1) & 0xFFF];
+}
+
+static bool overlaps(uint16_t addr, uint16_t start, uint16_t end){
+    addr &= 0xFFF;
+    return addr >= start && addr < end;
+}
+
+decoded_op decode_op_chip8(const uint8_t memory[0x1000], uint16_t addr){
+    addr &= 0xFFF;
+    decoded_op d = {fetch(memory, addr), {0, 0}, FUSED_NONE, 1};
+    if(addr + 6 > 0x1000) // sequences never wrap around the end of memory
+        return d;
+    uint16_t op0 = d.opcode;
+    uint16_t op1 = fetch(memory, addr + 2);
+    uint16_t op2 = fetch(memory, addr + 4);
+    d.next[0] = op1;
+    d.next[1] = op2;
+
+    if((op0 & 0xF000) == 0x6000 && (op1 & 0xF000) == 0x6000 && (op2 & 0xF000) == 0xD000){
+        d.fused = FUSED_SET_SET_DRAW;
+        d.length = 3;
+    }
+    else if((op0 & 0xF000) == 0xA000 && (op1 & 0xF0FF) == 0xF033 && op2 == 0xF265){
+        // the BCD digits must not land on the sequence itself, or F265 would change under us
+        uint16_t nnn = op0 & 0x0FFF;
+        bool self = false;
+        for(int i=0;i<3;i++)
+            self |= overlaps(nnn + i, addr, addr + 6);
+        if(!self){
+            d.fused = FUSED_BCD_LOAD;
+            d.length = 3;
+        }
+    }
+    else if((op0 & 0xF0FF) == 0xF029 && (op1 & 0xF000) == 0xD000){
+        d.fused = FUSED_FONT_DRAW;
+        d.length = 2;
+    }
+    else if((op0 & 0xF000) == 0x7000 && (op1 & 0xF000) == 0x3000 && (op2 & 0xF000) == 0x1000 &&
+            (op2 & 0x0FFF) != addr + 4){ // a jump to itself ends the program, leave it to the interpreter
+        d.fused = FUSED_COUNT_LOOP;
+        d.length = 3;
+    }
+    return d;
+}
+
+void decode_program_chip8(decoded_program &d, const chip8 &c){
+    for(int addr=0;addr<0x1000;addr++)
+        d.ops[addr] = decode_op_chip8(c.memory, addr);
+    d.invalidations = 0;
+}
+
+void invalidate_decoded_chip8(chip8 &c, uint16_t addr){
+#ifdef CHIP8_METRICS
+    if(c.metrics) [[unlikely]]
+        c.metrics->counters[vm_metrics::INVALIDATIONS].add(1);
+#endif
+    if(c.shared){ // the shared copy is read only, remember the address instead
+        c.shared->mark(addr);
+        return;
+    }
+    decoded_program &d = *c.decoded;
+    // a byte is read by the opcode starting at it or one before it, and by sequences starting up to
+    // 5 bytes before. Entries that do not cover it stay valid; they may miss a fusion the write
+    // made possible, which only costs speed.
+    for(int k=0;k<6;k++){
+        decoded_op &op = d.ops[(addr - k) & 0xFFF];
+        if(k < 2 || (op.fused != FUSED_STALE && k < op.length * 2))
+            op.fused = FUSED_STALE;
+    }
+    d.invalidations++;
+}
+
+int fused_sites_chip8(const decoded_program &d){
+    int n = 0;
+    for(const decoded_op &op : d.ops)
+        n += op.fused != FUSED_NONE && op.fused != FUSED_STALE;
+    return n;
+}
+
+bool valid_decoded_chip8(const decoded_program &d, const uint8_t memory[0x1000]){
+    for(int addr=0;addr<0x1000;addr++){
+        const decoded_op &op = d.ops[addr];
+        if(op.fused == FUSED_STALE) // decoded again before use
+            continue;
+        decoded_op want = decode_op_chip8(memory, addr);
+        if(op.opcode != want.opcode || op.next[0] != want.next[0] || op.next[1] != want.next[1] ||
+           op.fused != want.fused || op.length != want.length)
+            return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const decoded_program> shared_program_chip8(const chip8 &c, const uint8_t *program, size_t n){
+    static std::mutex m;
+    static std::unordered_map<uint64_t, std::weak_ptr<const decoded_program>> programs;
+    uint64_t key = rom_hash_chip8(program, n);
+
+    std::lock_guard<std::mutex> lock(m);
+    std::weak_ptr<const decoded_program> &slot = programs[key];
+    if(auto p = slot.lock())
+        return p;
+    for(auto it=programs.begin();it!=programs.end();){ // drop ROMs nobody runs any more
+        if(it->first != key && it->second.expired())
+            it = programs.erase(it);
+        else
+            ++it;
+    }
+    auto p = std::make_shared<decoded_program>();
+    decode_program_chip8(*p, c);
+    slot = p;
+    return p;
+}
+
+void shared_decoded::attach(chip8 &c, std::shared_ptr<const decoded_program> p){
+    program = std::move(p);
+    copy.reset();
+    memset(dirty, 0, sizeof(dirty));
+    // never written through: while c.shared is set, writes are diverted to mark()
+    c.decoded = const_cast<decoded_program *>(program.get());
+    c.shared = this;
+}
+
+void shared_decoded::unshare(chip8 &c){
+    copy = std::make_unique<decoded_program>(*program);
+    for(int a=0;a<0x1000;a++)
+        if(is_dirty(a))
+            copy->ops[a].fused = FUSED_STALE;
+    c.decoded = copy.get();
+    c.shared = nullptr;
+}
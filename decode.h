@@ -0,0 +1,85 @@
+#ifndef CHIP8_EMULATOR_DECODE_H
+#define CHIP8_EMULATOR_DECODE_H
+
+#include <cstdint>
+#include <memory>
+
+#include "chip8.h"
+
+// Pre-decoded copy of a machine's memory with superinstruction fusion.
+//
+// Every address holds the opcode that starts there and, when a common sequence starts
+// there, the fused handler that runs the whole sequence in one dispatch:
+//
+//   FUSED_SET_SET_DRAW  6XNN; 6YNN; DXYN    position and draw a sprite
+//   FUSED_BCD_LOAD      ANNN; FX33; F265    BCD digits of VX into V0..V2
+//   FUSED_FONT_DRAW     FX29; DXYN          draw a hex digit
+//   FUSED_COUNT_LOOP    7XNN; 3YKK; 1NNN    counter loop
+//
+// Fusion is keyed by the start address only, so a jump or skip into the middle of a sequence
+// runs the remaining instructions one by one. Attach with `c.decoded = &d` after
+// decode_program_chip8; intitialize_chip8 detaches it, like the trace. A store_chip8 that
+// changes memory marks the entries reading that byte stale and they are decoded again the
+// next time they run, so self-modifying code stays correct while data writes cost only the mark.
+//
+// The struct is plain data with no pointers so it can be copied or saved as is.
+
+enum fused_kind : uint8_t {
+    FUSED_NONE,
+    FUSED_SET_SET_DRAW,
+    FUSED_BCD_LOAD,
+    FUSED_FONT_DRAW,
+    FUSED_COUNT_LOOP,
+    FUSED_STALE = 0xFF, // memory under this entry changed, decode again before use
+};
+
+struct decoded_op {
+    uint16_t opcode;
+    uint16_t next[2]; // the following opcodes of a fused sequence
+    uint8_t fused;    // fused_kind starting at this address
+    uint8_t length;   // instructions covered by the fused handler, 1 when not fused
+};
+
+struct decoded_program {
+    decoded_op ops[0x1000];
+    uint64_t invalidations; // writes that changed a decoded byte
+};
+
+void decode_program_chip8(decoded_program &d, const chip8 &c);
+decoded_op decode_op_chip8(const uint8_t memory[0x1000], uint16_t addr); // one entry from memory
+int fused_sites_chip8(const decoded_program &d); // number of addresses with a fused handler
+bool valid_decoded_chip8(const decoded_program &d, const uint8_t memory[0x1000]); // every entry as decoded from memory
+
+// Process-wide registry: one decoded program per ROM, shared by every machine running it and
+// freed with the last reference. `c` must be freshly initialized with `program`.
+std::shared_ptr<const decoded_program> shared_program_chip8(const chip8 &c, const uint8_t *program, size_t n);
+
+// A machine's handle on a shared decoded program, owned by the embedder like a trace_ring.
+//
+// The machine runs straight from the shared copy. A write that changes memory only sets a
+// bit here; the machine takes a private copy the first time it is about to run an address
+// whose bytes changed, i.e. only once it has really written into its own code. Writes to
+// data (scores, sprites) never cost a copy.
+class shared_decoded {
+public:
+    void attach(chip8 &c, std::shared_ptr<const decoded_program> program); // after intitialize_chip8
+    bool is_private() const { return copy != nullptr; }
+
+    // used by the core
+    void mark(uint16_t addr){
+        for(int k=0;k<6;k++){ // the same entries invalidate_decoded_chip8 marks stale
+            uint16_t a = (addr - k) & 0xFFF;
+            if(k < program->ops[a].length * 2)
+                dirty[a>>6] |= 1ull << (a & 63);
+        }
+    }
+    bool is_dirty(uint16_t pc) const { return dirty[(pc & 0xFFF)>>6] >> (pc & 63) & 1; }
+    void unshare(chip8 &c); // switch c to a private copy with the changed entries stale
+
+private:
+    std::shared_ptr<const decoded_program> program;
+    std::unique_ptr<decoded_program> copy;
+    uint64_t dirty[0x1000 / 64];
+};
+
+#endif //CHIP8_EMULATOR_DECODE_H
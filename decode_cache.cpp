@@ -0,0 +1,97 @@
+#include "decode_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+decode_cache::~decode_cache(){
+    close();
+}
+
+bool decode_cache::map(uint64_t hash, size_t n, const chip8 &c){
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    const size_t expected = sizeof(decode_cache_header) + sizeof(decoded_program);
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size != expected){
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+    void *p = mmap(nullptr, expected, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED)
+        return false;
+
+    // the engine trusts every entry, so one that does not match the ROM in c.memory (a corrupt
+    // payload, or another ROM with the same hash) is a miss like a wrong header
+    const decode_cache_header *h = (const decode_cache_header *)p;
+    if(h->magic != DECODE_CACHE_MAGIC || h->version != CHIP8_DECODE_VERSION || h->rom_hash != hash ||
+       h->rom_size != n || h->program_size != sizeof(decoded_program) ||
+       !valid_decoded_chip8(*(const decoded_program *)((const uint8_t *)p + sizeof(decode_cache_header)), c.memory)){
+        munmap(p, expected);
+        errno = EINVAL;
+        return false;
+    }
+    base = p;
+    size = expected;
+    decoded = (decoded_program *)((uint8_t *)p + sizeof(decode_cache_header));
+    return true;
+}
+
+bool decode_cache::open(const std::string &dir, const chip8 &c, const uint8_t *program, size_t n){
+    close();
+    uint64_t hash = rom_hash_chip8(program, n);
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx-v%d.c8d", (unsigned long long)hash, CHIP8_DECODE_VERSION);
+    path = dir + name;
+
+    if(map(hash, n, c)){
+        hit = true;
+        return true;
+    }
+
+    // miss (or a file from another build): decode and store it
+    if(mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+        return false;
+    auto file = std::make_unique<uint8_t[]>(sizeof(decode_cache_header) + sizeof(decoded_program));
+    decode_cache_header *h = (decode_cache_header *)file.get();
+    memset(h, 0, sizeof(*h));
+    h->magic = DECODE_CACHE_MAGIC;
+    h->version = CHIP8_DECODE_VERSION;
+    h->rom_hash = hash;
+    h->rom_size = (uint32_t)n;
+    h->program_size = sizeof(decoded_program);
+    decode_program_chip8(*(decoded_program *)(file.get() + sizeof(decode_cache_header)), c);
+
+    std::string tmp = path + ".tmp" + std::to_string(getpid());
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if(!f)
+        return false;
+    bool ok = fwrite(file.get(), sizeof(decode_cache_header) + sizeof(decoded_program), 1, f) == 1;
+    ok &= fclose(f) == 0;
+    if(!ok || rename(tmp.c_str(), path.c_str()) != 0){
+        int err = errno;
+        remove(tmp.c_str());
+        errno = err;
+        return false;
+    }
+    hit = false;
+    return map(hash, n, c);
+}
+
+void decode_cache::close(){
+    if(base)
+        munmap(base, size);
+    base = nullptr;
+    decoded = nullptr;
+    size = 0;
+    hit = false;
+}
@@ -0,0 +1,63 @@
+#ifndef CHIP8_EMULATOR_DECODE_CACHE_H
+#define CHIP8_EMULATOR_DECODE_CACHE_H
+
+#include "chip8.h"
+#include "decode.h"
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Persistent cache of decoded programs (decode.h), one file per ROM:
+ *
+ *   <dir>/<rom hash>-v<CHIP8_DECODE_VERSION>.c8d      header | decoded_program
+ *
+ * The file is the decoded program exactly as it sits in memory, so a hit is one mmap and the
+ * machine runs fused from its first frame. The mapping is private: stale marks written by
+ * self-modifying code go to the process's own copy-on-write pages, never back to the file.
+ * Files are written to a temporary name and renamed, so workers starting together on the same
+ * cache directory either see a complete file or none.
+ */
+
+#define DECODE_CACHE_MAGIC 0x44433843u // "C8CD"
+
+// Bump when the decoded format, the fused handlers or any emulation quirk that decoding depends
+// on changes; older cache files are then ignored.
+#define CHIP8_DECODE_VERSION 1
+
+struct decode_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t rom_hash;
+    uint32_t rom_size;
+    uint32_t program_size; // sizeof(decoded_program)
+    uint8_t reserved[40];
+};
+static_assert(sizeof(decode_cache_header) == 64, "decoded program must start on a cache line");
+
+class decode_cache {
+public:
+    decode_cache() = default;
+    ~decode_cache();
+    decode_cache(const decode_cache &) = delete;
+    decode_cache &operator=(const decode_cache &) = delete;
+
+    // Map the decoded program of `program` from `dir`. On a miss `c`, which must be freshly
+    // initialized with `program`, is decoded and stored first. False (errno set) when the
+    // directory or file cannot be used; the caller can still decode without the cache.
+    bool open(const std::string &dir, const chip8 &c, const uint8_t *program, size_t n);
+    void close();
+
+    decoded_program *program() const { return decoded; }
+    bool hit = false; // the file was already there
+    std::string path;
+
+private:
+    bool map(uint64_t hash, size_t n, const chip8 &c);
+
+    void *base = nullptr;
+    size_t size = 0;
+    decoded_program *decoded = nullptr;
+};
+
+#endif //CHIP8_EMULATOR_DECODE_CACHE_H
@@ -0,0 +1,85 @@
+#include "disasm.h"
+
+#include <cstdio>
+
+bool disassemble_chip8(uint16_t opcode, char *buf, size_t size){
+    unsigned x = (opcode & 0x0F00)>>8;
+    unsigned y = (opcode & 0x00F0)>>4;
+    unsigned n = opcode & 0x000F;
+    unsigned nn = opcode & 0x00FF;
+    unsigned nnn = opcode & 0x0FFF;
+
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            if(opcode == 0x00E0) { snprintf(buf, size, "CLS"); return true; }
+            if(opcode == 0x00EE) { snprintf(buf, size, "RET"); return true; }
+            snprintf(buf, size, "SYS 0x%03X", nnn);
+            return true;
+        case 0x1000: snprintf(buf, size, "JP 0x%03X", nnn); return true;
+        case 0x2000: snprintf(buf, size, "CALL 0x%03X", nnn); return true;
+        case 0x3000: snprintf(buf, size, "SE V%X, 0x%02X", x, nn); return true;
+        case 0x4000: snprintf(buf, size, "SNE V%X, 0x%02X", x, nn); return true;
+        case 0x5000:
+            if(n != 0) break;
+            snprintf(buf, size, "SE V%X, V%X", x, y);
+            return true;
+        case 0x6000: snprintf(buf, size, "LD V%X, 0x%02X", x, nn); return true;
+        case 0x7000: snprintf(buf, size, "ADD V%X, 0x%02X", x, nn); return true;
+        case 0x8000:{
+            static const char *const ops[16] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                                                nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr};
+            if(!ops[n]) break;
+            snprintf(buf, size, "%s V%X, V%X", ops[n], x, y);
+            return true;
+        }
+        case 0x9000:
+            if(n != 0) break;
+            snprintf(buf, size, "SNE V%X, V%X", x, y);
+            return true;
+        case 0xA000: snprintf(buf, size, "LD I, 0x%03X", nnn); return true;
+        case 0xB000: snprintf(buf, size, "JP V0, 0x%03X", nnn); return true;
+        case 0xC000: snprintf(buf, size, "RND V%X, 0x%02X", x, nn); return true;
+        case 0xD000: snprintf(buf, size, "DRW V%X, V%X, %u", x, y, n); return true;
+        case 0xE000:
+            if(nn == 0x9E) { snprintf(buf, size, "SKP V%X", x); return true; }
+            if(nn == 0xA1) { snprintf(buf, size, "SKNP V%X", x); return true; }
+            break;
+        case 0xF000:
+            switch (nn) {
+                case 0x07: snprintf(buf, size, "LD V%X, DT", x); return true;
+                case 0x0A: snprintf(buf, size, "LD V%X, K", x); return true;
+                case 0x15: snprintf(buf, size, "LD DT, V%X", x); return true;
+                case 0x18: snprintf(buf, size, "LD ST, V%X", x); return true;
+                case 0x1E: snprintf(buf, size, "ADD I, V%X", x); return true;
+                case 0x29: snprintf(buf, size, "LD F, V%X", x); return true;
+                case 0x33: snprintf(buf, size, "LD B, V%X", x); return true;
+                case 0x55: snprintf(buf, size, "LD [I], V%X", x); return true;
+                case 0x65: snprintf(buf, size, "LD V%X, [I]", x); return true;
+            }
+            break;
+    }
+    snprintf(buf, size, "DW 0x%04X", opcode);
+    return false;
+}
+
+bool known_opcode_chip8(uint16_t opcode){
+    unsigned n = opcode & 0x000F;
+    unsigned nn = opcode & 0x00FF;
+    switch (opcode & 0xF000) {
+        case 0x5000:
+        case 0x9000:
+            return n == 0;
+        case 0x8000:
+            return n <= 7 || n == 0xE;
+        case 0xE000:
+            return nn == 0x9E || nn == 0xA1;
+        case 0xF000:
+            switch (nn) {
+                case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E:
+                case 0x29: case 0x33: case 0x55: case 0x65:
+                    return true;
+            }
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,15 @@
+#ifndef CHIP8_EMULATOR_DISASM_H
+#define CHIP8_EMULATOR_DISASM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Write the mnemonic of `opcode` (Cowgod's notation, e.g. "LD V0, 0x12", "DRW V0, V3, 5")
+// into buf. Returns false for opcodes the interpreter does not know, which are written as
+// "DW 0xNNNN".
+bool disassemble_chip8(uint16_t opcode, char *buf, size_t size);
+
+// Same verdict as disassemble_chip8 without formatting anything.
+bool known_opcode_chip8(uint16_t opcode);
+
+#endif //CHIP8_EMULATOR_DISASM_H
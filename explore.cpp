@@ -0,0 +1,204 @@
+#include "explore.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+bool is_input_opcode_chip8(uint16_t opcode){
+    if((opcode & 0xF0FF) == 0xF00A) // FX0A: wait for key
+        return true;
+    if((opcode & 0xF0FF) == 0xE09E || (opcode & 0xF0FF) == 0xE0A1) // EX9E / EXA1: skip on key state
+        return true;
+    return false;
+}
+
+namespace {
+
+// Number of distinct results an input instruction can have.
+int outcomes(uint16_t opcode){
+    return (opcode & 0xF000) == 0xF000 ? 16 : 2;
+}
+
+// Execute an input instruction as if the keypad produced result `outcome`.
+// FX0A: outcome is the key pressed. EX9E/EXA1: outcome 1 = key VX held, 0 = released.
+void apply_outcome(chip8 &c, uint16_t opcode, int outcome){
+    uint16_t x = (opcode & 0x0F00)>>8;
+    memset(c.key, 0, sizeof(c.key));
+    c.opcode = opcode;
+    if((opcode & 0xF000) == 0xF000){
+        c.key[outcome] = 1;
+        c.V[x] = outcome;
+        c.PC += 2;
+        return;
+    }
+    c.key[c.V[x] & 0xF] = outcome;
+    bool skip = (opcode & 0x00FF) == 0x9E ? outcome == 1 : outcome == 0;
+    c.PC += skip ? 4 : 2;
+}
+
+// Hashes of every state seen so far, split into shards so workers rarely contend on a lock.
+class seen_set {
+public:
+    bool insert(uint64_t h){
+        shard &s = shards[h >> 58];
+        std::lock_guard<std::mutex> lock(s.m);
+        return s.hashes.insert(h).second;
+    }
+private:
+    struct shard {
+        std::mutex m;
+        std::unordered_set<uint64_t> hashes;
+    };
+    shard shards[64];
+};
+
+// A machine stored as the cache lines of its chip8 that differ from the root machine: the
+// registers, the hashes, the screen rows drawn on and the memory written to, usually well under
+// 1KB instead of the whole chip8. Rebuilt by copying the root and patching those lines in.
+struct packed_state {
+    std::vector<uint8_t> lines; // line numbers, in order
+    std::vector<uint8_t> bytes; // CHIP8_CACHE_LINE bytes per line, the last one possibly shorter
+};
+
+const size_t LINES = (sizeof(chip8) + CHIP8_CACHE_LINE - 1) / CHIP8_CACHE_LINE;
+static_assert(LINES <= 256, "line numbers fit a byte");
+static_assert(std::is_trivially_copyable_v<chip8>, "lines are copied with memcpy");
+
+// A pending child is stored compactly as the packed parent (shared by all its siblings) plus the
+// outcome to apply; the full machine is only rebuilt when a worker picks it up.
+struct branch {
+    std::shared_ptr<const packed_state> parent;
+    uint16_t opcode;
+    int outcome;
+};
+
+class explorer {
+public:
+    explorer(const explore_options &opt) : opt(opt), pool(opt.threads ? opt.threads : std::thread::hardware_concurrency()) {}
+
+    explore_stats run(const chip8 &root){
+        this->root = std::make_unique<chip8>(root);
+        seen.insert(hash_chip8(root));
+        states = 1;
+        auto start = std::make_shared<chip8>(root);
+        pool.submit([this, start]{ chip8 c = *start; explore(c); });
+        pool.wait();
+
+        explore_stats s;
+        s.states = states;
+        s.duplicates = duplicates;
+        s.branch_points = branch_points;
+        s.halted = halted;
+        s.exhausted = exhausted;
+        s.truncated = truncated;
+        s.instructions = instructions;
+        return s;
+    }
+
+private:
+    // Run one machine until it halts, runs out of cycles or reaches an input instruction.
+    void explore(chip8 &c){
+        uint32_t cycles = 0;
+        for(;;){
+            if(cycles == opt.max_cycles){
+                exhausted++;
+                break;
+            }
+            uint16_t opcode = c.memory[c.PC & 0xFFF]<<8 | c.memory[(c.PC+1) & 0xFFF];
+            if(is_input_opcode_chip8(opcode)){
+                fork(c, opcode);
+                break;
+            }
+            uint16_t pc = c.PC;
+            emulateCyle_chip8(c);
+            cycles++;
+            if(c.PC == pc){
+                halted++;
+                break;
+            }
+            if(cycles % opt.cycles_per_frame == 0) // frame boundary, so delay timer waits end
+                tick_timers_chip8(c);
+        }
+        instructions += cycles;
+    }
+
+    std::shared_ptr<const packed_state> pack(const chip8 &c) const {
+        auto p = std::make_shared<packed_state>();
+        const uint8_t *from = (const uint8_t *)&c, *base = (const uint8_t *)root.get();
+        for(size_t l=0;l<LINES;l++){
+            size_t at = l * CHIP8_CACHE_LINE, n = std::min<size_t>(CHIP8_CACHE_LINE, sizeof(chip8) - at);
+            if(memcmp(from + at, base + at, n) != 0){
+                p->lines.push_back((uint8_t)l);
+                p->bytes.insert(p->bytes.end(), from + at, from + at + n);
+            }
+        }
+        return p;
+    }
+
+    void unpack(chip8 &c, const packed_state &p) const {
+        c = *root;
+        uint8_t *to = (uint8_t *)&c;
+        const uint8_t *src = p.bytes.data();
+        for(uint8_t l : p.lines){
+            size_t at = l * CHIP8_CACHE_LINE, n = std::min<size_t>(CHIP8_CACHE_LINE, sizeof(chip8) - at);
+            memcpy(to + at, src, n);
+            src += n;
+        }
+    }
+
+    void fork(const chip8 &c, uint16_t opcode){
+        branch_points++;
+        std::shared_ptr<const packed_state> parent; // packed once the first child is new
+        chip8 child;
+        for(int o=0;o<outcomes(opcode);o++){
+            child = c;
+            apply_outcome(child, opcode, o);
+            if(!seen.insert(hash_chip8(child))){
+                duplicates++;
+                continue;
+            }
+            if(states.fetch_add(1) >= opt.max_states){
+                states--;
+                truncated++;
+                continue;
+            }
+            if(!parent)
+                parent = pack(c);
+            branch b{parent, opcode, o};
+            pool.submit([this, b]{
+                chip8 next;
+                unpack(next, *b.parent);
+                apply_outcome(next, b.opcode, b.outcome);
+                explore(next);
+            });
+        }
+    }
+
+    const explore_options &opt;
+    std::unique_ptr<const chip8> root; // what packed states are stored against
+    seen_set seen;
+    std::atomic<uint64_t> states{0};
+    std::atomic<uint64_t> duplicates{0};
+    std::atomic<uint64_t> branch_points{0};
+    std::atomic<uint64_t> halted{0};
+    std::atomic<uint64_t> exhausted{0};
+    std::atomic<uint64_t> truncated{0};
+    std::atomic<uint64_t> instructions{0};
+    thread_pool pool; // last, so workers are joined before anything they touch is destroyed
+};
+
+} // namespace
+
+explore_stats explore_chip8(const chip8 &root, const explore_options &opt){
+    explore_options o = opt;
+    o.cycles_per_frame = std::max<uint32_t>(o.cycles_per_frame, 1);
+    explorer e(o);
+    return e.run(root);
+}
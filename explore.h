@@ -0,0 +1,36 @@
+#ifndef CHIP8_EMULATOR_EXPLORE_H
+#define CHIP8_EMULATOR_EXPLORE_H
+
+#include "chip8.h"
+
+#include <cstdint>
+
+// Exhaustive input exploration.
+// A machine runs until it reaches an instruction whose result depends on the keypad
+// (FX0A, EX9E, EXA1). There it is forked into one child per distinct outcome, the children
+// are deduplicated by state hash and every new child is run on the thread pool. A child waiting
+// for a worker is held as the cache lines where its parent differs from the root machine,
+// shared by its siblings.
+
+struct explore_options {
+    unsigned threads = 0;          // 0 = one per core
+    uint64_t max_states = 1000000; // stop forking after this many unique states
+    uint32_t max_cycles = 100000;  // per run, bounds ROMs that never touch the keypad
+    uint32_t cycles_per_frame = 10; // instructions between 60Hz timer ticks, as run_frame_chip8's cycles
+};
+
+struct explore_stats {
+    uint64_t states = 0;        // unique states queued (including the root)
+    uint64_t duplicates = 0;    // children dropped because their state was already seen
+    uint64_t branch_points = 0; // input dependent instructions reached
+    uint64_t halted = 0;        // runs that stopped on a jump to itself
+    uint64_t exhausted = 0;     // runs that used up max_cycles
+    uint64_t truncated = 0;     // new children not run because max_states was reached
+    uint64_t instructions = 0;  // instructions emulated by all runs
+};
+
+bool is_input_opcode_chip8(uint16_t opcode);
+
+explore_stats explore_chip8(const chip8 &root, const explore_options &opt);
+
+#endif //CHIP8_EMULATOR_EXPLORE_H
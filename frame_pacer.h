@@ -0,0 +1,55 @@
+#ifndef CHIP8_EMULATOR_FRAME_PACER_H
+#define CHIP8_EMULATOR_FRAME_PACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Paces a real time frame loop at 60Hz. Every frame is due by the start of the next one; a
+// frame still being worked on past that deadline is late, which only happens once the loop is a
+// whole frame behind. With shedding on, the output of late frames (presentation, shared memory,
+// recording) is skipped so the host time goes to emulating them, and the loop catches up instead
+// of running slow. Emulation, the input log and audio never skip. At most max_skip frames in a
+// row are shed, so the screen keeps moving on a host that never catches up.
+class frame_pacer {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr std::chrono::microseconds FRAME{16667};
+
+    explicit frame_pacer(bool shed, int max_skip = 4)
+        : shedding(shed), max_skip(max_skip), deadline(clock::now() + FRAME) {}
+
+    // After a frame is emulated: whether to produce its output. `last` frames always are.
+    bool present(bool last = false){
+        auto lag = clock::now() - deadline;
+        if(lag > clock::duration::zero()){
+            late++;
+            max_lag = std::max(max_lag, lag);
+            if(shedding && !last && skipped < max_skip){
+                skipped++;
+                shed++;
+                return false;
+            }
+        }
+        skipped = 0;
+        presented++;
+        return true;
+    }
+    // Sleeps until the next frame is due; returns at once while behind.
+    void wait(){
+        std::this_thread::sleep_until(deadline);
+        deadline += FRAME;
+    }
+
+    uint64_t presented = 0, shed = 0, late = 0; // frames
+    clock::duration max_lag = clock::duration::zero();
+
+private:
+    bool shedding;
+    int max_skip;
+    int skipped = 0; // shed in a row
+    clock::time_point deadline;
+};
+
+#endif //CHIP8_EMULATOR_FRAME_PACER_H
@@ -0,0 +1,295 @@
+#include "input_log.h"
+
+#include "decode.h"
+#ifdef CHIP8_METRICS
+#include "metrics.h"
+#endif
+#include "thread_pool.h"
+
+#include <cstring>
+#include <memory>
+
+static size_t put_varint(uint8_t *out, uint64_t v){
+    size_t n = 0;
+    while(v >= 0x80){
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool get_varint(const uint8_t *in, size_t n, size_t &pos, uint64_t &v){
+    v = 0;
+    for(int shift=0;shift<64;shift+=7){
+        if(pos >= n)
+            return false;
+        uint8_t b = in[pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if(!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void put_le(uint8_t *out, uint64_t v, int bytes){
+    for(int i=0;i<bytes;i++)
+        out[i] = (uint8_t)(v >> (8*i));
+}
+
+static uint64_t get_le(const uint8_t *in, int bytes){
+    uint64_t v = 0;
+    for(int i=0;i<bytes;i++)
+        v |= (uint64_t)in[i] << (8*i);
+    return v;
+}
+
+static const size_t HEADER_BYTES = 4 + 2 + 2 + 8 + 4 + 4 + 4 + 4;
+static const size_t HEADER_V1_BYTES = HEADER_BYTES - 4;
+
+uint16_t keys_chip8(const chip8 &c){
+    uint16_t mask = 0;
+    for(int k=0;k<16;k++)
+        mask |= (uint16_t)(c.key[k] != 0) << k;
+    return mask;
+}
+
+void set_keys_chip8(chip8 &c, uint16_t mask){
+#ifdef CHIP8_METRICS
+    if(c.metrics && mask != keys_chip8(c))
+        c.metrics->keys_changed(c);
+#endif
+    for(int k=0;k<16;k++)
+        c.key[k] = (mask >> k) & 1;
+}
+
+input_recorder::~input_recorder(){
+    close();
+}
+
+bool input_recorder::open(const std::string &path, const input_log_header &h){
+    close();
+    file = fopen(path.c_str(), "wb");
+    if(!file)
+        return false;
+    header = h;
+    last_frame = 0;
+    end_frame = 0;
+    last_keys = 0; // intitialize_chip8 releases every key
+    uint8_t out[HEADER_BYTES];
+    put_le(out, INPUT_LOG_MAGIC, 4);
+    put_le(out + 4, INPUT_LOG_VERSION, 2);
+    put_le(out + 6, 0, 2);
+    put_le(out + 8, h.rom_hash, 8);
+    put_le(out + 16, h.seed, 4);
+    put_le(out + 20, h.cycles_per_frame, 4);
+    put_le(out + 24, h.checkpoint_interval, 4);
+    put_le(out + 28, h.snapshot_interval, 4);
+    return fwrite(out, sizeof(out), 1, file) == 1;
+}
+
+void input_recorder::event(uint64_t frame, uint8_t type){
+    uint8_t out[10];
+    fwrite(out, put_varint(out, (frame - last_frame) << 2 | type), 1, file);
+    last_frame = frame;
+}
+
+void input_recorder::keys(uint64_t frame, uint16_t mask){
+    if(!file || mask == last_keys)
+        return;
+    event(frame, INPUT_KEYS);
+    uint8_t out[2];
+    put_le(out, mask, 2);
+    fwrite(out, sizeof(out), 1, file);
+    last_keys = mask;
+}
+
+void input_recorder::frame_done(uint64_t frame, const chip8 &c){
+    if(!file)
+        return;
+    end_frame = frame;
+    if(header.checkpoint_interval && (frame + 1) % header.checkpoint_interval == 0){
+        event(frame, INPUT_CHECKPOINT);
+        uint8_t out[8];
+        put_le(out, frame_hash_chip8(c), 8);
+        fwrite(out, sizeof(out), 1, file);
+    }
+    if(header.snapshot_interval && (frame + 1) % header.snapshot_interval == 0){
+        event(frame, INPUT_SNAPSHOT);
+        uint8_t out[CHIP8_STATE_BYTES];
+        save_state_chip8(c, out);
+        fwrite(out, sizeof(out), 1, file);
+    }
+}
+
+bool input_recorder::close(){
+    if(!file)
+        return true;
+    event(end_frame, INPUT_END);
+    bool ok = fclose(file) == 0;
+    file = nullptr;
+    return ok;
+}
+
+bool input_log::load(const std::string &path){
+    FILE *f = fopen(path.c_str(), "rb");
+    if(!f)
+        return false;
+    std::vector<uint8_t> data;
+    uint8_t buf[1 << 16];
+    size_t got;
+    while((got = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + got);
+    fclose(f);
+
+    uint64_t version = data.size() >= 6 ? get_le(data.data() + 4, 2) : 0;
+    size_t header_bytes = version == 1 ? HEADER_V1_BYTES : HEADER_BYTES;
+    if(data.size() < header_bytes || get_le(data.data(), 4) != INPUT_LOG_MAGIC || version < 1 || version > INPUT_LOG_VERSION)
+        return false;
+    header.rom_hash = get_le(data.data() + 8, 8);
+    header.seed = (uint32_t)get_le(data.data() + 16, 4);
+    header.cycles_per_frame = (uint32_t)get_le(data.data() + 20, 4);
+    header.checkpoint_interval = (uint32_t)get_le(data.data() + 24, 4);
+    header.snapshot_interval = version >= 2 ? (uint32_t)get_le(data.data() + 28, 4) : 0;
+
+    events.clear();
+    snapshots.clear();
+    complete = false;
+    frames = 0;
+    uint64_t frame = 0;
+    size_t pos = header_bytes;
+    uint64_t tag;
+    while(!complete && get_varint(data.data(), data.size(), pos, tag)){
+        input_event e{frame + (tag >> 2), (uint8_t)(tag & 3), 0};
+        static const size_t payload[4] = {2, 8, 0, CHIP8_STATE_BYTES};
+        size_t bytes = payload[e.type];
+        if(pos + bytes > data.size())
+            break; // torn tail of a log whose writer died
+        if(e.type == INPUT_SNAPSHOT){
+            e.value = snapshots.size();
+            snapshots.emplace_back(data.begin() + pos, data.begin() + pos + bytes);
+        }
+        else
+            e.value = get_le(data.data() + pos, (int)bytes);
+        pos += bytes;
+        frame = e.frame;
+        complete = e.type == INPUT_END;
+        if(!complete)
+            events.push_back(e);
+        frames = frame + 1;
+    }
+    return true;
+}
+
+replay_result replay_input_chip8(chip8 &c, const input_log &log, const uint8_t *program, size_t n,
+                                 const std::function<void(chip8 &)> &attach,
+                                 const std::function<void(const chip8 &, uint64_t frame)> &frame_done){
+    replay_result r;
+    intitialize_chip8(c, program, (int)n, log.header.seed);
+    if(attach)
+        attach(c);
+    size_t next = 0;
+    for(uint64_t frame=0;frame<log.frames;frame++){
+        while(next < log.events.size() && log.events[next].frame == frame && log.events[next].type == INPUT_KEYS)
+            set_keys_chip8(c, (uint16_t)log.events[next++].value);
+        bool running = run_frame_chip8(c, log.header.cycles_per_frame);
+        r.frames = frame + 1;
+        if(frame_done)
+            frame_done(c, frame);
+        for(;next < log.events.size() && log.events[next].frame == frame;next++){
+            const input_event &e = log.events[next];
+            if(e.type != INPUT_CHECKPOINT)
+                continue;
+            if(frame_hash_chip8(c) != e.value){
+                r.ok = false;
+                r.mismatch_frame = frame;
+                r.expected = e.value;
+                r.actual = frame_hash_chip8(c);
+                return r;
+            }
+            r.checkpoints++;
+        }
+        if(!running){
+            r.halted = true;
+            break;
+        }
+    }
+    return r;
+}
+
+std::vector<segment_result> verify_input_chip8(const input_log &log, const uint8_t *program, size_t n, unsigned threads){
+    if(!log.frames) // only a header, the recorder died before its first frame
+        return {};
+    // segment k starts after snapshot k-1 (power on for k = 0) and ends at snapshot k or the end
+    struct bound {
+        uint64_t frame;  // the snapshot was taken after this frame
+        size_t event;    // index of the snapshot event
+    };
+    std::vector<bound> snaps;
+    for(size_t i=0;i<log.events.size();i++)
+        if(log.events[i].type == INPUT_SNAPSHOT)
+            snaps.push_back({log.events[i].frame, i});
+
+    std::vector<segment_result> results(snaps.size() + 1);
+    chip8 root;
+    intitialize_chip8(root, program, (int)n, log.header.seed);
+    auto shared = shared_program_chip8(root, program, n);
+    const uint64_t cycles = log.header.cycles_per_frame;
+
+    auto segment = [&](size_t k){
+        segment_result &r = results[k];
+        auto c = std::make_unique<chip8>();
+        uint64_t frame = 0;
+        size_t next = 0;
+        if(k == 0)
+            intitialize_chip8(*c, program, (int)n, log.header.seed);
+        else{
+            load_state_chip8(*c, log.snapshots[log.events[snaps[k-1].event].value].data());
+            frame = snaps[k-1].frame + 1;
+            next = snaps[k-1].event + 1;
+        }
+        uint64_t end = k < snaps.size() ? snaps[k].frame : log.frames - 1;
+        r.first_frame = frame;
+        r.last_frame = end;
+        if(frame > end) // empty segment (two snapshots after the same frame)
+            return;
+        shared_decoded handle;
+        handle.attach(*c, shared);
+
+        auto fail = [&](uint64_t f, std::string what){
+            r.ok = false;
+            r.mismatch_frame = f;
+            r.mismatch_frame_end = (f + 1) * cycles;
+            r.what = std::move(what);
+        };
+        for(;frame<=end;frame++){
+            while(next < log.events.size() && log.events[next].frame == frame && log.events[next].type == INPUT_KEYS)
+                set_keys_chip8(*c, (uint16_t)log.events[next++].value);
+            bool running = run_frame_chip8(*c, (int)cycles);
+            for(;next < log.events.size() && log.events[next].frame == frame;next++){
+                const input_event &e = log.events[next];
+                if(e.type == INPUT_CHECKPOINT && frame_hash_chip8(*c) != e.value){
+                    char buf[80];
+                    snprintf(buf, sizeof(buf), "screen hash %016llx != %016llx",
+                             (unsigned long long)frame_hash_chip8(*c), (unsigned long long)e.value);
+                    return fail(frame, buf);
+                }
+                if(e.type == INPUT_SNAPSHOT){
+                    auto expected = std::make_unique<chip8>();
+                    load_state_chip8(*expected, log.snapshots[e.value].data());
+                    std::string diff = diff_state_chip8(*c, *expected);
+                    if(!diff.empty())
+                        return fail(frame, diff);
+                }
+            }
+            if(!running && frame < end)
+                return fail(frame, "program halted before the recorded end");
+        }
+    };
+
+    thread_pool pool(threads);
+    for(size_t k=0;k<results.size();k++)
+        pool.submit([&segment, k]{ segment(k); });
+    pool.wait();
+    return results;
+}
@@ -0,0 +1,118 @@
+#ifndef CHIP8_EMULATOR_INPUT_LOG_H
+#define CHIP8_EMULATOR_INPUT_LOG_H
+
+#include "chip8.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Input log (.c8i): every change of the keypad plus screen hash checkpoints, enough to replay
+ * a session exactly, and optionally full machine snapshots so it can be verified in parallel. Keys are only ever changed between frames, so an event is tagged with the
+ * frame it applies to; the instruction number is frame * cycles_per_frame. All integers are
+ * little endian:
+ *
+ *   header   "C8IN" u32 | version u16 | reserved u16 | rom hash u64 | seed u32
+ *            | cycles per frame u32 | checkpoint interval u32 | snapshot interval u32 (version 2)
+ *   events   varint (frames since the previous event << 2 | type), then
+ *              type 0 keys       : u16 key bitmask, bit k = key k down, held from this frame on
+ *              type 1 checkpoint : u64 frame_hash_chip8 after this frame ran
+ *              type 2 end        : nothing, the session ran up to and including this frame
+ *              type 3 snapshot   : CHIP8_STATE_BYTES of save_state_chip8 after this frame ran
+ *
+ * A held key costs nothing; a press and release is 6 bytes, a checkpoint 9-10 bytes.
+ */
+
+#define INPUT_LOG_MAGIC 0x4E493843u // "C8IN"
+#define INPUT_LOG_VERSION 2
+
+enum input_event_type : uint8_t { INPUT_KEYS, INPUT_CHECKPOINT, INPUT_END, INPUT_SNAPSHOT };
+
+struct input_event {
+    uint64_t frame;
+    uint8_t type;
+    uint64_t value; // key bitmask, frame hash or index into input_log::snapshots
+};
+
+struct input_log_header {
+    uint64_t rom_hash;
+    uint32_t seed;
+    uint32_t cycles_per_frame;
+    uint32_t checkpoint_interval;
+    uint32_t snapshot_interval; // 0 = no snapshots
+};
+
+uint16_t keys_chip8(const chip8 &c);            // key[] as a bitmask
+void set_keys_chip8(chip8 &c, uint16_t mask);
+
+class input_recorder {
+public:
+    input_recorder() = default;
+    ~input_recorder();
+    input_recorder(const input_recorder &) = delete;
+    input_recorder &operator=(const input_recorder &) = delete;
+
+    bool open(const std::string &path, const input_log_header &h);
+    bool is_open() const { return file != nullptr; }
+    void keys(uint64_t frame, uint16_t mask);       // before the frame runs; written only on change
+    void frame_done(uint64_t frame, const chip8 &c); // after it ran; writes a checkpoint/snapshot when due
+    bool close();                                    // writes the end marker
+
+private:
+    void event(uint64_t frame, uint8_t type);
+
+    FILE *file = nullptr;
+    input_log_header header = {};
+    uint64_t last_frame = 0;
+    uint64_t end_frame = 0;
+    uint16_t last_keys = 0;
+};
+
+// A whole log in memory.
+struct input_log {
+    input_log_header header = {};
+    std::vector<input_event> events;
+    std::vector<std::vector<uint8_t>> snapshots;
+    uint64_t frames = 0; // frames in the session
+    bool complete = false; // ended with an end marker (the recorder was closed)
+
+    bool load(const std::string &path);
+};
+
+struct replay_result {
+    bool ok = true;
+    uint64_t frames = 0;       // frames replayed
+    uint64_t checkpoints = 0;  // checkpoints that matched
+    uint64_t mismatch_frame = 0;
+    uint64_t expected = 0, actual = 0;
+    bool halted = false;
+};
+
+// Run the session again from a fresh machine, as fast as possible, stopping at the first
+// checkpoint whose screen hash differs. `c` is initialized here; `attach` runs right after that
+// and may attach a decoded program, trace, ...; `frame_done` runs after every frame.
+replay_result replay_input_chip8(chip8 &c, const input_log &log, const uint8_t *program, size_t n,
+                                 const std::function<void(chip8 &)> &attach = {},
+                                 const std::function<void(const chip8 &, uint64_t frame)> &frame_done = {});
+
+// One stretch of a session between two snapshots, replayed on its own.
+struct segment_result {
+    uint64_t first_frame;  // first frame replayed
+    uint64_t last_frame;   // the snapshot (or end) this segment is checked against
+    bool ok = true;
+    uint64_t mismatch_frame = 0;      // frame after which the first check failed
+    uint64_t mismatch_frame_end = 0;  // instructions run since power on at the end of that frame;
+                                      // the log has no state inside a frame, so the divergence is
+                                      // only known to lie in the cycles_per_frame before it
+    std::string what;                 // screen hash or first differing state field
+};
+
+// Split the session at its snapshots and replay every segment on the pool, each from the
+// snapshot before it, checking screen hash checkpoints on the way and the full state against
+// the snapshot after it. Results are in session order, empty for a log without frames.
+std::vector<segment_result> verify_input_chip8(const input_log &log, const uint8_t *program, size_t n, unsigned threads);
+
+#endif //CHIP8_EMULATOR_INPUT_LOG_H
@@ -0,0 +1,459 @@
+#include "job_server.h"
+#include "decode.h"
+#include "metrics.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct job_server::job {
+    std::string id = "-";
+    std::string rom;         // file path
+    std::string bundle_name;
+    uint64_t hash = 0;       // bundle entry by rom hash, 0 = not given
+    std::string input;
+    uint32_t seed = 1;
+    int cycles = 10;
+    uint64_t frames = 600;
+    uint64_t every = 60;
+    bool want_frames = false, want_gfx = false, want_state = false;
+};
+
+struct job_server::rom_entry {
+    std::vector<uint8_t> owned; // file ROMs; bundle ROMs point into the mapping
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    uint64_t hash = 0;
+    std::shared_ptr<const decoded_program> decoded; // held here so it stays decoded between jobs
+    struct stat file = {};      // size and mtime when loaded, for file ROMs
+};
+
+struct job_server::log_entry {
+    input_log log;
+    struct stat file = {};
+};
+
+struct job_server::connection {
+    int fd;
+    std::mutex m;
+
+    explicit connection(int fd) : fd(fd) {}
+    ~connection(){ close(fd); }
+
+    void send(const std::string &s){
+        std::lock_guard<std::mutex> lock(m);
+        for(size_t done=0;done<s.size();){
+            ssize_t k = ::send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+            if(k <= 0)
+                return; // the client went away; its other jobs still run
+            done += k;
+        }
+    }
+};
+
+static bool same_file(const struct stat &a, const struct stat &b){
+    return a.st_size == b.st_size && a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+template <class T>
+std::shared_ptr<const T> job_server::lru_cache<T>::get(const std::string &key){
+    auto it = slots.find(key);
+    if(it == slots.end())
+        return nullptr;
+    it->second.used = ++tick;
+    return it->second.value;
+}
+
+template <class T>
+void job_server::lru_cache<T>::put(const std::string &key, std::shared_ptr<const T> value){
+    slots[key] = {std::move(value), ++tick};
+    if(slots.size() <= capacity)
+        return;
+    auto oldest = slots.begin(); // a scan per insertion past the cap, cheap next to a load
+    for(auto it=slots.begin();it!=slots.end();++it)
+        if(it->second.used < oldest->second.used)
+            oldest = it;
+    slots.erase(oldest);
+}
+
+job_server::job_server(unsigned threads) : pool(threads) {}
+
+job_server::~job_server(){
+    pool.wait(); // jobs use the caches below
+    if(listen_fd >= 0){
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+}
+
+bool job_server::open_bundle(const std::string &path){
+    return bundle.open(path);
+}
+
+bool job_server::listen(const std::string &path){
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path)){
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str()); // left over from a server that did not shut down cleanly
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listen_fd < 0)
+        return false;
+    if(bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listen_fd, 64) != 0){
+        int e = errno;
+        close(listen_fd);
+        listen_fd = -1;
+        errno = e;
+        return false;
+    }
+    socket_path = path;
+    return true;
+}
+
+void job_server::serve(){
+    while(!stopping){
+        pollfd p = {listen_fd, POLLIN, 0};
+        if(poll(&p, 1, 200) <= 0)
+            continue; // timeout or signal, check for stop()
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(fd < 0)
+            continue;
+        for(size_t i=0;i<clients.size();){
+            if(clients[i].second.expired()){
+                clients[i].first.join();
+                clients.erase(clients.begin() + i);
+            }
+            else
+                i++;
+        }
+        auto conn = std::make_shared<connection>(fd);
+        clients.emplace_back(std::thread([this, conn]{ client(conn); }), conn);
+    }
+    for(auto &c : clients)
+        c.first.join();
+    clients.clear();
+    pool.wait();
+}
+
+void job_server::client(std::shared_ptr<connection> conn){
+    std::string partial;
+    char buf[4096];
+    while(!stopping){
+        pollfd p = {conn->fd, POLLIN, 0};
+        if(poll(&p, 1, 200) <= 0)
+            continue;
+        ssize_t n = read(conn->fd, buf, sizeof(buf));
+        if(n <= 0)
+            break;
+        partial.append(buf, n);
+        size_t eol;
+        bool quit = false;
+        while(!quit && (eol = partial.find('\n')) != std::string::npos){
+            std::string line = partial.substr(0, eol);
+            partial.erase(0, eol + 1);
+            if(!line.empty() && line.back() == '\r')
+                line.pop_back();
+            std::string cmd = line.substr(0, line.find(' '));
+            if(cmd == "run"){
+                auto j = std::make_shared<job>();
+                std::string error;
+                if(!parse(line, *j, error)){
+                    errors++;
+                    conn->send(j->id + " error " + error + "\n");
+                    continue;
+                }
+                clock::time_point queued = clock::now();
+                pool.submit([this, conn, j, queued]{ run_job(*j, queued, [&conn](const std::string &s){ conn->send(s); }); });
+            }
+            else if(cmd == "stats")
+                conn->send(stats());
+            else if(cmd == "metrics")
+                conn->send(metrics_prometheus(vm_metrics::default_registry().snapshot()) + "# EOF\n");
+            else if(cmd == "quit")
+                quit = true;
+            else if(!cmd.empty())
+                conn->send("- error unknown command " + cmd + "\n");
+        }
+        if(quit)
+            break;
+    }
+    // jobs still queued hold the connection, finish writing to it and close it
+}
+
+bool job_server::parse(const std::string &line, job &j, std::string &error){
+    std::istringstream in(line);
+    std::string word;
+    in >> word; // "run"
+    while(in >> word){
+        size_t eq = word.find('=');
+        if(eq == std::string::npos){
+            error = "expected key=value, got " + word;
+            return false;
+        }
+        std::string key = word.substr(0, eq), value = word.substr(eq + 1);
+        if(key == "id")
+            j.id = value;
+        else if(key == "rom")
+            j.rom = value;
+        else if(key == "bundle")
+            j.bundle_name = value;
+        else if(key == "hash")
+            j.hash = std::strtoull(value.c_str(), nullptr, 16);
+        else if(key == "input")
+            j.input = value;
+        else if(key == "seed")
+            j.seed = std::strtoul(value.c_str(), nullptr, 0);
+        else if(key == "cycles")
+            j.cycles = std::atoi(value.c_str());
+        else if(key == "frames")
+            j.frames = std::strtoull(value.c_str(), nullptr, 0);
+        else if(key == "every")
+            j.every = std::strtoull(value.c_str(), nullptr, 0);
+        else if(key == "want"){
+            std::istringstream wants(value);
+            std::string w;
+            while(std::getline(wants, w, ',')){
+                if(w == "frames")
+                    j.want_frames = true;
+                else if(w == "gfx")
+                    j.want_gfx = true;
+                else if(w == "state")
+                    j.want_state = true;
+                else if(w != "hash"){
+                    error = "unknown output " + w;
+                    return false;
+                }
+            }
+        }
+        else{
+            error = "unknown key " + key;
+            return false;
+        }
+    }
+    if(j.rom.empty() + j.bundle_name.empty() + !j.hash != 2){
+        error = "give exactly one of rom=, bundle=, hash=";
+        return false;
+    }
+    if(j.cycles < 1 || j.every < 1){
+        error = "cycles and every must be positive";
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const job_server::rom_entry> job_server::find_rom(const job &j, bool &hit, std::string &error){
+    struct stat st = {};
+    std::string key;
+    if(!j.rom.empty()){
+        if(stat(j.rom.c_str(), &st) != 0){
+            error = j.rom + ": " + strerror(errno);
+            return nullptr;
+        }
+        key = "file:" + j.rom;
+    }
+    else
+        key = j.hash ? "hash:" + std::to_string(j.hash) : "bundle:" + j.bundle_name;
+
+    {
+        std::lock_guard<std::mutex> lock(cache_m);
+        std::shared_ptr<const rom_entry> cached = roms.get(key);
+        if(cached && (j.rom.empty() || same_file(cached->file, st))){
+            hit = true;
+            return cached;
+        }
+    }
+    hit = false;
+
+    // load and decode unlocked; two jobs missing on the same ROM at once both load it, the
+    // later one replaces the earlier entry
+
+    auto e = std::make_shared<rom_entry>();
+    if(!j.rom.empty()){
+        if(!load_rom_chip8(j.rom, e->owned)){
+            error = "cannot read " + j.rom;
+            return nullptr;
+        }
+        e->data = e->owned.data();
+        e->size = e->owned.size();
+        e->file = st;
+    }
+    else{
+        rom_view v;
+        if(j.hash ? !bundle.find(j.hash, v) : !bundle.find(std::string_view(j.bundle_name), v)){
+            error = "no such ROM in the bundle";
+            return nullptr;
+        }
+        e->data = v.data;
+        e->size = v.size;
+    }
+    e->hash = rom_hash_chip8(e->data, e->size);
+    auto scratch = std::make_unique<chip8>(); // shared_program_chip8 decodes from a fresh machine
+    intitialize_chip8(*scratch, e->data, (int)e->size);
+    e->decoded = shared_program_chip8(*scratch, e->data, e->size);
+    std::lock_guard<std::mutex> lock(cache_m);
+    roms.put(key, e);
+    return e;
+}
+
+std::shared_ptr<const input_log> job_server::find_log(const std::string &path, std::string &error){
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0){
+        error = path + ": " + strerror(errno);
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(cache_m);
+        std::shared_ptr<const log_entry> cached = logs.get(path);
+        if(cached && same_file(cached->file, st)){
+            log_hits++;
+            return std::shared_ptr<const input_log>(cached, &cached->log);
+        }
+    }
+    log_misses++;
+    auto e = std::make_shared<log_entry>();
+    if(!e->log.load(path)){
+        error = "cannot read input log " + path;
+        return nullptr;
+    }
+    e->file = st;
+    std::lock_guard<std::mutex> lock(cache_m);
+    logs.put(path, e);
+    return std::shared_ptr<const input_log>(e, &e->log);
+}
+
+std::string job_server::run(const std::string &line){
+    job j;
+    std::string error;
+    if(!parse(line, j, error)){
+        errors++;
+        return j.id + " error " + error + "\n";
+    }
+    std::string out;
+    run_job(j, clock::now(), [&out](const std::string &s){ out += s; });
+    return out;
+}
+
+void job_server::run_job(const job &j, clock::time_point queued, const sink &send){
+    clock::time_point start = clock::now();
+    std::string out; // lines not sent yet
+    std::string error;
+    bool hit = false;
+    std::shared_ptr<const rom_entry> rom = find_rom(j, hit, error);
+    std::shared_ptr<const input_log> log;
+    if(rom && !j.input.empty()){
+        log = find_log(j.input, error);
+        if(log && log->header.rom_hash != rom->hash){
+            error = j.input + " was recorded with a different ROM";
+            log.reset();
+        }
+    }
+    if(!rom || (!j.input.empty() && !log)){
+        errors++;
+        return send(j.id + " error " + error + "\n");
+    }
+    (hit ? rom_hits : rom_misses)++;
+
+    // one machine per worker, reused by every job it runs
+    static thread_local chip8 c;
+    static thread_local shared_decoded shared;
+    static std::atomic<int> workers{0};
+    static thread_local vm_metrics metrics("worker-" + std::to_string(workers++));
+    char buf[128];
+    clock::time_point flushed = start;
+    auto attach = [&](chip8 &m){
+        shared.attach(m, rom->decoded);
+        metrics.reset_pending(); // a key change from the previous job is not this job's latency
+        m.metrics = &metrics;
+    };
+    auto frame_done = [&](const chip8 &m, uint64_t frame){
+        if(j.want_frames && (frame + 1) % j.every == 0){
+            snprintf(buf, sizeof(buf), "%s frame %llu %016llx\n", j.id.c_str(), (unsigned long long)frame + 1,
+                     (unsigned long long)frame_hash_chip8(m));
+            out += buf;
+            if(out.size() >= 4096 || clock::now() - flushed >= std::chrono::milliseconds(20)){
+                send(out);
+                out.clear();
+                flushed = clock::now();
+            }
+        }
+    };
+
+    uint64_t ran = 0;
+    int cycles = j.cycles;
+    bool halted = false;
+    std::string replay;
+    if(log){
+        replay_result r = replay_input_chip8(c, *log, rom->data, rom->size, attach, frame_done);
+        ran = r.frames;
+        cycles = (int)log->header.cycles_per_frame;
+        halted = r.halted;
+        replay = r.ok ? " replay=ok" : " replay=diverged@" + std::to_string(r.mismatch_frame);
+    }
+    else{
+        intitialize_chip8(c, rom->data, (int)rom->size, j.seed);
+        attach(c);
+        while(ran < j.frames && !halted){
+            halted = !run_frame_chip8(c, cycles);
+            frame_done(c, ran++);
+        }
+    }
+
+    if(j.want_gfx){
+        uint64_t rows[32];
+        pack_gfx_chip8(c, rows);
+        out += j.id + " gfx";
+        for(uint64_t row : rows){
+            snprintf(buf, sizeof(buf), " %016llx", (unsigned long long)row);
+            out += buf;
+        }
+        out += "\n";
+    }
+    if(j.want_state){
+        static const char digits[] = "0123456789abcdef";
+        uint8_t state[CHIP8_STATE_BYTES];
+        save_state_chip8(c, state);
+        out += j.id + " state ";
+        for(uint8_t b : state){
+            out += digits[b >> 4];
+            out += digits[b & 15];
+        }
+        out += "\n";
+    }
+
+    clock::time_point end = clock::now();
+    auto us = [](clock::duration d){ return (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+    snprintf(buf, sizeof(buf), " ok frames=%llu cycles=%d halted=%d hash=%016llx frame_hash=%016llx",
+             (unsigned long long)ran, cycles, halted, (unsigned long long)hash_chip8(c),
+             (unsigned long long)frame_hash_chip8(c));
+    out += j.id + buf + replay;
+    snprintf(buf, sizeof(buf), " rom=%s queue_us=%llu run_us=%llu\n", hit ? "hit" : "miss", us(start - queued), us(end - start));
+    out += buf;
+
+    jobs++;
+    frames += ran;
+    busy_us += us(end - start);
+    send(out);
+}
+
+std::string job_server::stats() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "stats workers=%u jobs=%llu errors=%llu frames=%llu busy_us=%llu rom_hits=%llu rom_misses=%llu "
+             "log_hits=%llu log_misses=%llu\n", pool.size(), (unsigned long long)jobs, (unsigned long long)errors,
+             (unsigned long long)frames, (unsigned long long)busy_us, (unsigned long long)rom_hits,
+             (unsigned long long)rom_misses, (unsigned long long)log_hits, (unsigned long long)log_misses);
+    return buf;
+}
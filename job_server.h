@@ -0,0 +1,116 @@
+#ifndef CHIP8_EMULATOR_JOB_SERVER_H
+#define CHIP8_EMULATOR_JOB_SERVER_H
+
+#include "input_log.h"
+#include "rom_bundle.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct decoded_program;
+
+/*
+ * Batch job server: a long running process that takes emulation jobs over a Unix domain socket
+ * and runs them on its worker pool, so a job pays neither process startup nor ROM loading nor
+ * decoding. ROMs (files, revalidated by size and mtime, or entries of a mapped bundle), their
+ * decoded programs and input logs stay cached between jobs, and every worker keeps its own
+ * machine, so a short job costs little more than intitialize_chip8 and the frames it runs.
+ * Both caches keep the most recently used entries up to a fixed count; loading and decoding on
+ * a miss happen outside the cache lock, so a miss never holds up the other workers.
+ *
+ * The protocol is line based text. A client sends one job per line
+ *
+ *   run id=ID (rom=PATH | bundle=NAME | hash=HEX) [seed=N] [cycles=N] [frames=N]
+ *       [input=LOG.c8i] [every=N] [want=hash,frames,gfx,state]
+ *
+ * and may send more before the first one finishes. Jobs run concurrently and their results are
+ * streamed back while they run, every line tagged with the job id. Frame lines go out in batches
+ * of a few KB or every 20 ms, so lines of concurrent jobs may interleave between batches; the ok
+ * or error line is always the last line of its job:
+ *
+ *   ID frame N FRAME_HASH         want=frames: the screen hash after every `every` frames (60)
+ *   ID gfx ROW0 ... ROW31         want=gfx: the final screen, 32 rows of 64 pixels in hex
+ *   ID state HEX                  want=state: save_state_chip8 of the final machine
+ *   ID ok frames=N cycles=N halted=0|1 hash=H frame_hash=H [replay=ok|diverged@FRAME]
+ *         rom=hit|miss queue_us=N run_us=N
+ *   ID error MESSAGE
+ *
+ * Without input= a job runs `frames` frames (default 600) with no key down. With input= it
+ * replays the log instead, with the log's seed, cycles per frame and keys, and checks its
+ * checkpoints. "stats" answers with the server counters, "metrics" with the metrics of the
+ * worker machines (metrics.h) as Prometheus text ending in "# EOF", "quit" ends the connection.
+ */
+class job_server {
+public:
+    explicit job_server(unsigned threads = std::thread::hardware_concurrency());
+    ~job_server();
+    job_server(const job_server &) = delete;
+    job_server &operator=(const job_server &) = delete;
+
+    bool open_bundle(const std::string &path); // serve bundle= and hash= from it
+    bool listen(const std::string &path);     // false (errno set) if the socket cannot be bound
+    void serve();                              // accept clients until stop(), then drain the jobs
+    void stop(){ stopping = true; }            // async signal safe
+
+    std::string run(const std::string &line);  // one "run" line, synchronously; for embedders
+    std::string stats() const;
+
+private:
+    struct job;
+    struct rom_entry;
+    struct log_entry;
+    struct connection;
+    using clock = std::chrono::steady_clock;
+    using sink = std::function<void(const std::string &)>;
+
+    // Keyed cache that drops its least recently used entry past `capacity`. Jobs holding an
+    // entry keep it alive through their shared_ptr after it is dropped. Guarded by cache_m.
+    template <class T>
+    struct lru_cache {
+        struct slot {
+            std::shared_ptr<const T> value;
+            uint64_t used;
+        };
+        size_t capacity;
+        uint64_t tick = 0;
+        std::unordered_map<std::string, slot> slots;
+
+        explicit lru_cache(size_t capacity) : capacity(capacity) {}
+        std::shared_ptr<const T> get(const std::string &key);
+        void put(const std::string &key, std::shared_ptr<const T> value);
+    };
+    static constexpr size_t ROM_CACHE = 1024; // ROMs with their decoded programs, about 40KB each
+    static constexpr size_t LOG_CACHE = 64;
+
+    static bool parse(const std::string &line, job &j, std::string &error);
+    void client(std::shared_ptr<connection> conn);
+    void run_job(const job &j, clock::time_point queued, const sink &send); // send gets whole lines
+    std::shared_ptr<const rom_entry> find_rom(const job &j, bool &hit, std::string &error);
+    std::shared_ptr<const input_log> find_log(const std::string &path, std::string &error);
+
+    thread_pool pool;
+    rom_bundle bundle;
+    int listen_fd = -1;
+    std::string socket_path;
+    std::atomic<bool> stopping{false};
+    std::vector<std::pair<std::thread, std::weak_ptr<connection>>> clients; // reaped once closed
+
+    std::mutex cache_m; // guards both caches
+    lru_cache<rom_entry> roms{ROM_CACHE};
+    lru_cache<log_entry> logs{LOG_CACHE};
+
+    std::atomic<uint64_t> jobs{0}, errors{0}, rom_hits{0}, rom_misses{0}, log_hits{0}, log_misses{0};
+    std::atomic<uint64_t> frames{0}, busy_us{0};
+};
+
+#endif //CHIP8_EMULATOR_JOB_SERVER_H
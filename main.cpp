@@ -1,258 +1,321 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
-#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
-/*
- * Link to Chip 8 refrence : http://devernay.free.fr/hacks/chip8/C8TECH10.HTM
-Chip 8 Memory Map (total memory 4kb):
-
-|-----8-Bits----|
-
-+---------------+= 0xFFF (4095) End of Chip-8 RAM
-|               |
-|               |
-|               |
-|               |
-|               |
-| 0x200 to 0xFFF|
-|     Chip-8    |
-| Program / Data|
-|     Space     |
-|               |
-|               |
-|               |
-+- - - - - - - -+= 0x600 (1536) Start of ETI 660 Chip-8 programs
-|               |
-|               |
-|               |
-+---------------+= 0x200 (512) Start of most Chip-8 programs
-| 0x000 to 0x1FF|
-| Reserved for  |
-|  interpreter  |
-+---------------+= 0x000 (0) Start of Chip-8 RAM
-
-    - 0x000-0x1FF - Chip 8 interpreter (contains font set in emu) [First 512 bytes are reserved]
-    - 0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F) [Part of reserved (80) bytes for font set]
-    - 0x200-0xFFF - Program ROM and work RAM [Part of Ram that can be used by programs]
-
- Registers:
-    -  There are total 16 (8 bit) registers named as V0,V1,...Vf
-    -  There is also special 16 bit I register which stores address lower 12 bits(0x000-0x1ff)
-    -  Vf register is not used by program, it used as flag register
-    - Program Counter (PC) should be 16 bit (points to address of next instruction to be executed)
-    - Stack pointer should be 8 bit (points to top of the stack)
-    - Stack is an array of 16 16bit value, address to return to after the subroutine has finished
-
-Instructions
-    - Chip-8 language includes 36 different instructions
-    - All instructions are 2 bytes long and are stored most-significant-byte first
-    - In memory, the first byte of each instruction should be located at an even addresses.
-    - If a program includes sprite data, it should be padded so any instructions following it will be properly situated in RAM.
-
-Graphics
-    - The graphics system: The chip 8 has one instruction that draws sprite to the screen. Drawing is done in XOR mode and
-        if a pixel is turned off as a result of drawing, the VF register is set. This is used for collision detection.
-    - The graphics of the Chip 8 are black and white and the screen has a total of 2048 pixels (64 x 32).
-        This can easily be implemented using an array that hold the pixel state (1 or 0):
- */
-
-
-
-uint16_t opcode ; // store op code
-uint8_t memory[0x1000]; // 4KB memory
-uint8_t V[16]; // 16 8 bit genral purpose register
-
-uint16_t PC ; // 16 bit PC register
-uint8_t SP ; // 16 bit SP register [SP always points to last address to pop]
-uint16_t I ; // 16 bit index register I
-uint16_t stack[16]; // 16 level stack
-
-uint8_t gfx[64 * 32] ; // black & white screen
-
-uint8_t delay_timer; // timer register
-uint8_t sound_timer; // timer register
-
-uint8_t key[16]; //  array to store the current state of the key
-
-// chip 8 font set
-uint8_t chip8_fontset[80]={
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-};
-
-void intitialize_chip8(uint8_t program[], int n){
-    PC =  0x200; // PC starts at 0x200
-    opcode = 0; // Reset opcode
-    I = 0; // Reset index register
-    SP = 0; // Reset stack pointer
+#include "audio.h"
+#include "chip8.h"
+#include "debugger.h"
+#include "decode.h"
+#include "decode_cache.h"
+#include "frame_pacer.h"
+#include "input_log.h"
+#include "metrics.h"
+#include "profile.h"
+#include "recorder.h"
+#include "render_thread.h"
+#include "shm_export.h"
+#include "term_keyboard.h"
+#include "term_renderer.h"
+#include "trace.h"
+
+chip8 chip; // the machine being emulated
+
+static std::atomic<bool> dump_trace{false}; // set by SIGUSR1
+static std::atomic<bool> dump_metrics{false}; // set by SIGUSR2
+
+static void usage(const char *argv0) {
+    std::cerr<<"usage: "<<argv0<<" [rom.ch8] [options]\n"
+             <<"  --frames N     stop after N frames (default: run until the program halts)\n"
+             <<"  --cycles N     instructions per 60Hz frame (default 10)\n"
+             <<"  --turbo        do not throttle to 60 frames per second\n"
+             <<"  --shed         when behind the 60Hz deadline, skip the drawing, --shm and --record output\n"
+             <<"                 of frames until caught up (frames are still emulated; only their output\n"
+             <<"                 is skipped), and report how many\n"
+             <<"  --shm NAME     publish every frame to POSIX shared memory NAME (e.g. /chip8)\n"
+             <<"  --record FILE  record every frame to FILE (.c8v, see recorder.h)\n"
+             <<"  --wav FILE     write the beeper to FILE (16-bit mono WAV)\n"
+             <<"  --rate N       audio sample rate (default 44100)\n"
+             <<"  --trace FILE   record an execution trace, dumped to FILE on a fault, on SIGUSR1 and at exit\n"
+             <<"  --profile FILE write a guest hot-spot report to FILE and folded call stacks to FILE.folded\n"
+             <<"  --metrics FILE write counters and latency histograms to FILE (.json, else Prometheus text) on SIGUSR2 and at exit\n"
+             <<"  --cache DIR    keep the decoded program of the ROM in DIR and map it on later starts\n"
+             <<"  --input FILE   record every keypad change and a screen hash checkpoint to FILE (.c8i)\n"
+             <<"  --checkpoint N frames between checkpoints in the input log (default 60)\n"
+             <<"  --snapshot N   frames between full state snapshots in the input log, for Chip8_verify (default 3600)\n"
+             <<"  --replay FILE  replay an input log unthrottled, verify its checkpoints and exit\n"
+             <<"  --debug        read debugger commands (breakpoints, watchpoints, stepping) from stdin; \"help\" lists them\n"
+             <<"  --render       draw the screen in the terminal (ANSI, changed cells only) from a render thread\n";
+}
 
-    memset(gfx, 0, sizeof(gfx));       // clear display
-    memset(stack, 0 , sizeof(stack));  // clear stack
-    memset(V, 0, sizeof(V));           // clear registers
-    memset(memory, 0, sizeof(memory)); // clear memory
+int main(int argc, char **argv) {
+    std::string test_prg = "../test.ch8"; // program to load
+    uint64_t max_frames = 0;
+    int cycles_per_frame = 10;
+    bool turbo = false;
+    bool shed = false;
+    std::string shm_name;
+    bool render = false;
+    std::string record_path;
+    std::string wav_path;
+    uint32_t sample_rate = 44100;
+    std::string trace_path;
+    std::string profile_path;
+    std::string metrics_path;
+    std::string cache_dir;
+    std::string input_path;
+    std::string replay_path;
+    uint32_t checkpoint_interval = 60;
+    uint32_t snapshot_interval = 3600;
+    bool debug = false;
+    for(int i=1;i<argc;i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--frames" && i+1 < argc)
+            max_frames = std::strtoull(argv[++i], nullptr, 0);
+        else if(arg == "--cycles" && i+1 < argc)
+            cycles_per_frame = std::atoi(argv[++i]);
+        else if(arg == "--turbo")
+            turbo = true;
+        else if(arg == "--shed")
+            shed = true;
+        else if(arg == "--shm" && i+1 < argc)
+            shm_name = argv[++i];
+        else if(arg == "--record" && i+1 < argc)
+            record_path = argv[++i];
+        else if(arg == "--wav" && i+1 < argc)
+            wav_path = argv[++i];
+        else if(arg == "--rate" && i+1 < argc)
+            sample_rate = std::strtoul(argv[++i], nullptr, 0);
+        else if(arg == "--trace" && i+1 < argc)
+            trace_path = argv[++i];
+        else if(arg == "--profile" && i+1 < argc)
+            profile_path = argv[++i];
+        else if(arg == "--metrics" && i+1 < argc)
+            metrics_path = argv[++i];
+        else if(arg == "--cache" && i+1 < argc)
+            cache_dir = argv[++i];
+        else if(arg == "--input" && i+1 < argc)
+            input_path = argv[++i];
+        else if(arg == "--checkpoint" && i+1 < argc)
+            checkpoint_interval = std::strtoul(argv[++i], nullptr, 0);
+        else if(arg == "--snapshot" && i+1 < argc)
+            snapshot_interval = std::strtoul(argv[++i], nullptr, 0);
+        else if(arg == "--replay" && i+1 < argc)
+            replay_path = argv[++i];
+        else if(arg == "--debug")
+            debug = true;
+        else if(arg == "--render")
+            render = true;
+        else if(arg[0] != '-')
+            test_prg = arg;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
 
-    // load font set
-     memcpy(memory+0x05, chip8_fontset, sizeof(chip8_fontset)); // copy 80 bytes
+    std::vector<uint8_t> program;
+    if(!load_rom_chip8(test_prg, program))
+    {
+        std::cerr<<"Fail to read complete file";
+        exit(1);
+    }
+    int n = program.size();
 
-    // reset timers
-    delay_timer = 0;
-    sound_timer = 0;
+    if(!replay_path.empty())
+    {
+        input_log log;
+        if(!log.load(replay_path))
+        {
+            std::cerr<<"Fail to read input log "<<replay_path<<"\n";
+            exit(1);
+        }
+        if(log.header.rom_hash != rom_hash_chip8(program.data(), n))
+            std::cerr<<"warning: "<<replay_path<<" was recorded with a different ROM\n";
+        std::shared_ptr<const decoded_program> shared;
+        shared_decoded handle;
+        auto start = std::chrono::steady_clock::now();
+        replay_result r = replay_input_chip8(chip, log, program.data(), n, [&](chip8 &c){
+            shared = shared_program_chip8(c, program.data(), n);
+            handle.attach(c, shared);
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("replayed %llu of %llu frames (%.1f s of play) in %.3f s, %llu checkpoints matched%s\n",
+               (unsigned long long)r.frames, (unsigned long long)log.frames, r.frames / 60.0, seconds,
+               (unsigned long long)r.checkpoints, log.complete ? "" : " (log has no end marker)");
+        if(!r.ok)
+        {
+            printf("MISMATCH after frame %llu: screen hash %016llx, recorded %016llx\n",
+                   (unsigned long long)r.mismatch_frame, (unsigned long long)r.actual, (unsigned long long)r.expected);
+            return 2;
+        }
+        return 0;
+    }
 
-    // Loading the program into the memory
-    memcpy(memory + 0x200, program, n);
-}
+    shm_frame_writer shm;
+    if(!shm_name.empty() && !shm.create(shm_name))
+    {
+        std::cerr<<"Fail to create shared memory "<<shm_name<<": "<<strerror(errno)<<"\n";
+        exit(1);
+    }
 
+    frame_recorder recorder;
+    if(!record_path.empty() && !recorder.open(record_path))
+    {
+        std::cerr<<"Fail to create "<<record_path<<"\n";
+        exit(1);
+    }
 
-void emulateCyle_chip8(){
-    // Fetch opcode
-    // Big Endian hence, MSB is at lower address
-    uint8_t MSB = memory[PC];
-    uint8_t LSB = memory[PC+1];
-    opcode = (MSB<<8) | LSB;
+    // In turbo runs the samples go straight to the file from this thread, so the output
+    // is deterministic; in real time they go through the ring to the playback thread.
+    beep_synth synth(sample_rate);
+    wav_writer wav;
+    std::unique_ptr<audio_output> audio;
+    std::vector<int16_t> samples(synth.max_frame_samples());
+    if(!wav_path.empty())
+    {
+        if(!wav.open(wav_path, synth.rate()))
+        {
+            std::cerr<<"Fail to create "<<wav_path<<"\n";
+            exit(1);
+        }
+        if(!turbo)
+            audio = std::make_unique<audio_output>(synth.rate(), [&wav](const int16_t *s, size_t n){ wav.write(s, n); });
+    }
 
+    term_renderer terminal;
+    std::unique_ptr<render_thread> renderer;
+    if(render)
+        renderer = std::make_unique<render_thread>([&terminal](const packed_frame &f){ terminal.present(f); });
 
-    // Decode and Execute
-    switch (opcode & 0xF000) {
-        case 0x0000:{
-            switch (opcode){
-                case 0x00E0:{ // clear screen
-                    memset(gfx, 0, sizeof(gfx));       // clear display
-                    PC += 2;
-                    break;
-                }
-                case 0x00EE:{ //return from subroutine
-                    // restore address from stack and decrement SP
-                    PC = stack[SP];
-                    SP -= 1;
-                    break;
-                }
-                default:{ assert(false && "Wrong Opcode"); }
-            }
-            break;
-        }
-        case 0x1000:{ // 1NNN: goto NNN
-            uint16_t nnn = opcode & 0x0FFF;
-            PC = nnn;
-            break;
-        }
-        case 0x2000:{ // 2NNN: Calls subroutine at NNN.
-            uint16_t nnn = opcode & 0x0FFF;
-            SP += 1;
-            stack[SP] = PC;
-            PC = nnn;
-            break;
-        }
-        case 0x6000:{ // 6XNN: Sets VX to NN.
-            uint16_t x = (opcode & 0x0F00)>>8;
-            uint16_t nn = opcode & 0x00FF;
-            V[x] = nn;
-            PC += 2;
-            break;
-        }
-        case 0xA000:{ // ANNN: set I to NNN
-            I = opcode & 0x0FFF;
-            PC += 2;
-            break;
-        }
-        case 0xC000:{ // CXNN: Rand Vx = rand() & nn
-            uint16_t x = (opcode & 0x0F00)>>8;
-            uint8_t nn = opcode & 0x00FF;
-            uint8_t r = (rand()%256);
-            V[x] = r & nn;
-            PC += 2;
-            break;
-        }
-        case 0xD000:{ // AXYN:draw(Vx, Vy, N)
-            uint16_t x = (opcode & 0x0F00)>>8;
-            uint16_t y = (opcode & 0x00F0)>>4;
-            uint16_t n = opcode & 0x000F;
-            // draw(V[x],V[y],n)
-            PC += 2;
-            break;
-        }
-        case 0xF00:{
-            switch (opcode & 0xF0FF){
-                case 0xF00A:{  // wait for input
-                    uint16_t x = (opcode & 0x0F00)>>8;
-                    char c  = (char)getchar();
-                    V[x] = c;
-                    PC += 2;
-                    break;
-                }
-                case 0xF033:{  // set_BCD(Vx) *(I+0) = BCD(3); *(I+1) = BCD(2); *(I+2) = BCD(1);
-                    uint16_t x = (opcode & 0x0F00)>>8;
-                    uint16_t n = V[x];
-                    memory[I + 2] = (n%10);
-                    n /= 10;
-                    memory[I + 1] = (n%10);
-                    n /= 10;
-                    memory[I] = (n%10);
-                    n /= 10;
-                    PC += 2;
-                    break;
-                }
-                case 0xF065:{  //reg_load(Vx, &I) Fills V0 to VX (including VX) with values from memory starting at address I.
-                    uint16_t x = (opcode & 0x0F00)>>8;
-                    for(int i=0;i<=x;i++)
-                        V[i] = memory[I+i];
-                    PC += 2;
-                    break;
-                }
-                case 0xF029:{  //I = sprite_addr[Vx]
-                    uint16_t x = (opcode & 0x0F00)>>8;
-                    I = V[x];
-                    PC += 2;
-                    break;
-                }
-            }
-        }
+   intitialize_chip8(chip, program.data(), n); // initailize registers and load program to memory
 
+    std::unique_ptr<trace_ring> trace;
+    if(!trace_path.empty())
+    {
+        trace = std::make_unique<trace_ring>();
+        trace->fault_path = trace_path;
+        chip.trace = trace.get();
+        signal(SIGUSR1, [](int){ dump_trace = true; });
+    }
+    std::unique_ptr<guest_profiler> profile;
+    if(!profile_path.empty())
+    {
+        profile = std::make_unique<guest_profiler>();
+        chip.profile = profile.get();
+    }
+    std::unique_ptr<vm_metrics> metrics;
+    if(!metrics_path.empty())
+    {
+        metrics = std::make_unique<vm_metrics>("main");
+        chip.metrics = metrics.get();
+        signal(SIGUSR2, [](int){ dump_metrics = true; });
+    }
+    // fused superinstructions; the trace and profiler bypass them while attached
+    decode_cache cache;
+    std::unique_ptr<decoded_program> decoded;
+    if(!cache_dir.empty() && cache.open(cache_dir, chip, program.data(), n))
+        chip.decoded = cache.program();
+    else
+    {
+        if(!cache_dir.empty())
+            std::cerr<<"decode cache "<<cache_dir<<" unusable ("<<strerror(errno)<<"), decoding in memory\n";
+        decoded = std::make_unique<decoded_program>();
+        decode_program_chip8(*decoded, chip);
+        chip.decoded = decoded.get();
     }
-}
-
-#define MAX 3584
-int main() {
-    std::string test_prg = "../test.ch8"; // program to load
-    std::ifstream file(test_prg, std::ios::binary); // read program
-    uint8_t program[MAX];
 
-    file.read((char *)program,MAX);
-    if(!file.eof())
+    term_keyboard keyboard(debug ? -1 : 0); // inactive unless stdin is a terminal; the debugger owns it with --debug
+    std::unique_ptr<debugger> dbg;
+    if(debug)
+        dbg = std::make_unique<debugger>();
+    input_recorder input;
+    if(!input_path.empty() && !input.open(input_path, {rom_hash_chip8(program.data(), n), 1, (uint32_t)cycles_per_frame, checkpoint_interval, snapshot_interval}))
     {
-        std::cerr<<"Fail to read complete file";
+        std::cerr<<"Fail to create "<<input_path<<"\n";
         exit(1);
     }
-    int n = file.gcount();// get total bytes read
-    file.close();
 
-   intitialize_chip8(program, n); // initailize registers and load program to memory
-   for(int i=0;i<n/2;++i)
+   frame_pacer pacer(shed);
+   for(uint64_t frame=0; max_frames==0 || frame<max_frames; ++frame)
    {
-       emulateCyle_chip8();
+       uint16_t keys = keyboard.poll();
+       if(keyboard.quit)
+           break;
+       set_keys_chip8(chip, keys);
+       input.keys(frame, keys);
+       if(dbg)
+       {
+           dbg->sync(chip);
+           if(dbg->quit())
+               break;
+       }
+       bool running = run_frame_chip8(chip, cycles_per_frame);
+       input.frame_done(frame, chip);
+       bool output = turbo || pacer.present(!running || frame + 1 == max_frames);
+       if(!output && metrics)
+           metrics->counters[vm_metrics::SHED_FRAMES].add(1);
+       if(output)
+           shm.publish(chip);
+       if(trace && dump_trace.exchange(false))
+           trace->dump(trace_path);
+       if(metrics && dump_metrics.exchange(false))
+           write_metrics_file(metrics_path, vm_metrics::default_registry().snapshot());
+       if(renderer && output)
+           renderer->submit(chip, frame);
+       if(recorder.is_open() && !output)
+           recorder.skip(); // the recording keeps its timing, the shed frame repeats the last one
+       else if(recorder.is_open())
+       {
+           uint64_t rows[32];
+           pack_gfx_chip8(chip, rows);
+           recorder.add(rows);
+       }
+       if(wav.is_open())
+       {
+           size_t count = synth.frame(chip, samples.data());
+           if(audio)
+               audio->push(samples.data(), count);
+           else
+               wav.write(samples.data(), count);
+       }
+       if(!running)
+           break;
+       if(!turbo)
+           pacer.wait();
    }
+   if(shed && !turbo)
+       fprintf(stderr, "shed %llu of %llu frames (%.1f%%), %llu late, max lag %.1f ms\n",
+               (unsigned long long)pacer.shed, (unsigned long long)(pacer.shed + pacer.presented),
+               pacer.shed + pacer.presented ? 100.0 * pacer.shed / (pacer.shed + pacer.presented) : 0.0,
+               (unsigned long long)pacer.late, std::chrono::duration<double, std::milli>(pacer.max_lag).count());
 
 
 
+    input.close();
+    if(trace)
+        trace->dump(trace_path);
+    if(metrics && !write_metrics_file(metrics_path, vm_metrics::default_registry().snapshot()))
+        std::cerr<<"Fail to write "<<metrics_path<<": "<<strerror(errno)<<"\n";
+    if(profile)
+    {
+        profile->write_report(profile_path, chip);
+        profile->write_folded(profile_path + ".folded");
+    }
 
     // check if programing was copied correctly to memory
 //   for(int i=0;i<n;i++)
 //   {
-//       assert(program[i]==memory[0x200+i] && "Program copy failed");
+//       assert(program[i]==chip.memory[0x200+i] && "Program copy failed");
 //       printf("%x ",program[i]);
 //   }
 
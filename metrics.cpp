@@ -0,0 +1,216 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+uint64_t metrics_now_ns(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void histogram_data::add(const latency_histogram &h){
+    for(int b=0;b<latency_histogram::BUCKETS;b++)
+        counts[b] += h.counts[b].get();
+    total += h.total.get();
+    sum += h.sum.get();
+    largest = std::max(largest, h.largest.get());
+}
+
+void histogram_data::add(const histogram_data &h){
+    for(int b=0;b<latency_histogram::BUCKETS;b++)
+        counts[b] += h.counts[b];
+    total += h.total;
+    sum += h.sum;
+    largest = std::max(largest, h.largest);
+}
+
+uint64_t histogram_data::quantile(double q) const {
+    // the cells are read one by one while the writer runs, so use their own sum as the total
+    uint64_t n = 0;
+    for(uint64_t k : counts)
+        n += k;
+    if(!n)
+        return 0;
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * n + 0.5));
+    uint64_t seen = 0;
+    for(int b=0;b<latency_histogram::BUCKETS;b++){
+        seen += counts[b];
+        if(seen >= rank){
+            uint64_t upper = b + 1 < latency_histogram::BUCKETS ? latency_histogram::lower_bound(b + 1) - 1 : largest;
+            return std::max(latency_histogram::lower_bound(b), std::min(upper, largest));
+        }
+    }
+    return largest;
+}
+
+const char *vm_metrics::name(int k){
+    static const char *const names[COUNT] = {"instructions", "frames", "draws", "collisions", "input_waits",
+                                             "fused_loop_repeats", "decode_invalidations", "shed_frames"};
+    return names[k];
+}
+
+metrics_registry &vm_metrics::default_registry(){
+    static metrics_registry r;
+    return r;
+}
+
+vm_metrics::vm_metrics(std::string vm_name, metrics_registry &registry) : vm_name(std::move(vm_name)), registry(registry) {
+    std::lock_guard<std::mutex> lock(registry.m);
+    registry.live.push_back(this);
+}
+
+vm_metrics::~vm_metrics(){
+    std::lock_guard<std::mutex> lock(registry.m);
+    registry.live.erase(std::find(registry.live.begin(), registry.live.end(), this));
+    for(int k=0;k<COUNT;k++)
+        registry.retired.counters[k] += counters[k].get();
+    registry.retired.frame_time.add(frame_time);
+    registry.retired.input_latency.add(input_latency);
+}
+
+metrics_snapshot metrics_registry::snapshot(){
+    metrics_snapshot s;
+    std::lock_guard<std::mutex> lock(m);
+    s.total = retired;
+    s.total.name = "total";
+    for(vm_metrics *v : live){
+        metrics_snapshot::vm out;
+        out.name = v->vm_name;
+        for(int k=0;k<vm_metrics::COUNT;k++)
+            out.counters[k] = v->counters[k].get();
+        out.frame_time.add(v->frame_time);
+        out.input_latency.add(v->input_latency);
+        for(int k=0;k<vm_metrics::COUNT;k++)
+            s.total.counters[k] += out.counters[k];
+        s.total.frame_time.add(out.frame_time);
+        s.total.input_latency.add(out.input_latency);
+        s.vms.push_back(std::move(out));
+    }
+    return s;
+}
+
+namespace {
+
+const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+std::string json_histogram(const histogram_data &h){
+    char buf[96];
+    std::string out = "{\"count\": " + std::to_string(h.total) + ", \"sum_ns\": " + std::to_string(h.sum) +
+                      ", \"max_ns\": " + std::to_string(h.largest);
+    for(double q : QUANTILES){
+        snprintf(buf, sizeof(buf), ", \"p%g_ns\": %llu", q * 100, (unsigned long long)h.quantile(q));
+        out += buf;
+    }
+    // non-empty buckets as [lower bound, count] pairs, enough to merge snapshots later
+    out += ", \"buckets\": [";
+    bool first = true;
+    for(int b=0;b<latency_histogram::BUCKETS;b++){
+        if(!h.counts[b])
+            continue;
+        snprintf(buf, sizeof(buf), "%s[%llu, %llu]", first ? "" : ", ",
+                 (unsigned long long)latency_histogram::lower_bound(b), (unsigned long long)h.counts[b]);
+        out += buf;
+        first = false;
+    }
+    return out + "]}";
+}
+
+std::string json_vm(const metrics_snapshot::vm &v, const char *indent){
+    std::string out = std::string(indent) + "{\"name\": " + metrics_json_string(v.name);
+    for(int k=0;k<vm_metrics::COUNT;k++)
+        out += std::string(", \"") + vm_metrics::name(k) + "\": " + std::to_string(v.counters[k]);
+    out += ",\n" + std::string(indent) + " \"frame_time\": " + json_histogram(v.frame_time);
+    out += ",\n" + std::string(indent) + " \"input_latency\": " + json_histogram(v.input_latency) + "}";
+    return out;
+}
+
+// Prometheus summary: quantiles in seconds plus _sum and _count.
+std::string prometheus_summary(const std::string &metric, const std::string &labels, const histogram_data &h){
+    char buf[160];
+    std::string out;
+    std::string sep = labels.empty() ? "" : labels + ",";
+    for(double q : QUANTILES){
+        snprintf(buf, sizeof(buf), "%s{%squantile=\"%g\"} %.9f\n", metric.c_str(), sep.c_str(), q, h.quantile(q) / 1e9);
+        out += buf;
+    }
+    std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    snprintf(buf, sizeof(buf), "%s_sum%s %.9f\n%s_count%s %llu\n", metric.c_str(), braces.c_str(), h.sum / 1e9,
+             metric.c_str(), braces.c_str(), (unsigned long long)h.total);
+    return out + buf;
+}
+
+std::string prometheus_label(const std::string &s){
+    std::string out;
+    for(char ch : s){
+        if(ch == '"' || ch == '\\')
+            out += '\\';
+        if(ch == '\n')
+            out += "\\n";
+        else
+            out += ch;
+    }
+    return out;
+}
+
+} // namespace
+
+std::string metrics_json_string(const std::string &s){
+    std::string out = "\"";
+    for(char ch : s){
+        if(ch == '"' || ch == '\\')
+            out += '\\';
+        if((unsigned char)ch >= 0x20)
+            out += ch;
+    }
+    return out + "\"";
+}
+
+std::string metrics_json(const metrics_snapshot &s){
+    std::string out = "{\n  \"total\": " + json_vm(s.total, "") + ",\n  \"vms\": [\n";
+    for(size_t i=0;i<s.vms.size();i++)
+        out += json_vm(s.vms[i], "    ") + (i + 1 < s.vms.size() ? ",\n" : "\n");
+    return out + "  ]\n}\n";
+}
+
+std::string metrics_prometheus(const metrics_snapshot &s){
+    // totals over the process, then the same per live machine with a vm label
+    std::string out;
+    for(int k=0;k<vm_metrics::COUNT;k++){
+        std::string metric = std::string("chip8_") + vm_metrics::name(k) + "_total";
+        out += "# TYPE " + metric + " counter\n" + metric + " " + std::to_string(s.total.counters[k]) + "\n";
+    }
+    out += "# TYPE chip8_frame_seconds summary\n" + prometheus_summary("chip8_frame_seconds", "", s.total.frame_time);
+    out += "# TYPE chip8_input_latency_seconds summary\n" +
+           prometheus_summary("chip8_input_latency_seconds", "", s.total.input_latency);
+    if(s.vms.empty())
+        return out;
+    for(int k=0;k<vm_metrics::COUNT;k++){
+        std::string metric = std::string("chip8_vm_") + vm_metrics::name(k) + "_total";
+        out += "# TYPE " + metric + " counter\n";
+        for(const metrics_snapshot::vm &v : s.vms)
+            out += metric + "{vm=\"" + prometheus_label(v.name) + "\"} " + std::to_string(v.counters[k]) + "\n";
+    }
+    out += "# TYPE chip8_vm_frame_seconds summary\n";
+    for(const metrics_snapshot::vm &v : s.vms)
+        out += prometheus_summary("chip8_vm_frame_seconds", "vm=\"" + prometheus_label(v.name) + "\"", v.frame_time);
+    out += "# TYPE chip8_vm_input_latency_seconds summary\n";
+    for(const metrics_snapshot::vm &v : s.vms)
+        out += prometheus_summary("chip8_vm_input_latency_seconds", "vm=\"" + prometheus_label(v.name) + "\"", v.input_latency);
+    return out;
+}
+
+bool write_metrics_file(const std::string &path, const metrics_snapshot &s){
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    std::string text = json ? metrics_json(s) : metrics_prometheus(s);
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if(!f)
+        return false;
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = fclose(f) == 0 && ok;
+    if(!ok || rename(tmp.c_str(), path.c_str()) != 0){
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,165 @@
+#ifndef CHIP8_EMULATOR_METRICS_H
+#define CHIP8_EMULATOR_METRICS_H
+
+#include "chip8.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Runtime metrics: per-machine counters and latency histograms, summed over every machine in
+ * the process on demand and exported as a JSON snapshot or a Prometheus text file.
+ *
+ * A vm_metrics block is attached to one machine (c.metrics) and, like the machine, is written by
+ * one thread at a time. Its cells are relaxed atomics updated with a plain load and store, never
+ * a locked read-modify-write, so counting costs the same as a plain increment. A snapshot reads
+ * the cells of every registered block while the machines keep running; it never stops or locks
+ * them (the registry lock only guards blocks coming and going). A block that goes away folds its
+ * counts into the registry first, so totals never go backwards.
+ *
+ * The core counts per frame, per draw and per FX0A wait; nothing is added to the per-instruction
+ * path. Frame time is measured around every 16th run_frame_chip8, and only while a block is
+ * attached.
+ */
+
+uint64_t metrics_now_ns(); // steady clock
+
+// A cell with a single writer.
+struct metric_cell {
+    std::atomic<uint64_t> v{0};
+
+    void add(uint64_t n){ v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void max(uint64_t n){ if(n > get()) v.store(n, std::memory_order_relaxed); }
+    uint64_t get() const { return v.load(std::memory_order_relaxed); }
+};
+
+// HDR style histogram of nanosecond values: exact below 64, then every power of two is split in
+// 32 linear buckets, so any recorded value is known to within 1/32 (3%) up to 2^41 ns (36 min).
+class latency_histogram {
+public:
+    static constexpr int SUB_BITS = 6;
+    static constexpr int MAX_SHIFT = 41 - SUB_BITS;
+    static constexpr int BUCKETS = (MAX_SHIFT + 1) * (1 << (SUB_BITS - 1)) + (1 << (SUB_BITS - 1));
+
+    static int bucket(uint64_t ns){
+        if(ns >> SUB_BITS == 0)
+            return (int)ns;
+        int shift = 63 - __builtin_clzll(ns) - SUB_BITS + 1;
+        if(shift > MAX_SHIFT)
+            return BUCKETS - 1;
+        return (shift << (SUB_BITS - 1)) + (int)(ns >> shift);
+    }
+    static uint64_t lower_bound(int b){ // smallest value that lands in bucket b
+        if(b < (1 << SUB_BITS))
+            return (uint64_t)b;
+        int shift = b / (1 << (SUB_BITS - 1)) - 1;
+        return (uint64_t)(b - (shift << (SUB_BITS - 1))) << shift;
+    }
+
+    void record(uint64_t ns){
+        counts[bucket(ns)].add(1);
+        total.add(1);
+        sum.add(ns);
+        largest.max(ns);
+    }
+
+    metric_cell counts[BUCKETS];
+    metric_cell total, sum, largest;
+};
+
+// A histogram read out of one or more latency_histograms.
+struct histogram_data {
+    std::vector<uint64_t> counts = std::vector<uint64_t>(latency_histogram::BUCKETS);
+    uint64_t total = 0, sum = 0, largest = 0;
+
+    void add(const latency_histogram &h);
+    void add(const histogram_data &h);
+    uint64_t quantile(double q) const; // upper edge of the bucket holding the q-th value, 0 if empty
+};
+
+class metrics_registry;
+
+class vm_metrics {
+public:
+    enum counter { INSTRUCTIONS, FRAMES, DRAWS, COLLISIONS, INPUT_WAITS, LOOP_REPEATS, INVALIDATIONS, SHED_FRAMES, COUNT };
+    // LOOP_REPEATS: extra passes the fused engine ran of a counting loop (7XNN; 3XKK; 1NNN jumping
+    // back to itself) after its first; the interpreter does not count them.
+    // SHED_FRAMES is counted by the real time loop (frame_pacer.h), not the core
+    static const char *name(int k);
+
+    explicit vm_metrics(std::string vm_name, metrics_registry &registry = default_registry());
+    ~vm_metrics();
+    vm_metrics(const vm_metrics &) = delete;
+    vm_metrics &operator=(const vm_metrics &) = delete;
+
+    static metrics_registry &default_registry();
+
+    const std::string vm_name;
+    metric_cell counters[COUNT];
+    latency_histogram frame_time;    // host time per run_frame_chip8, sampled
+    latency_histogram input_latency; // key change (set_keys_chip8) to the first draw that changes the screen
+
+    // used by the core
+    static constexpr uint64_t FRAME_SAMPLE = 16; // frames per timed frame; two clock reads cost about a short frame
+    bool timing_frame() const { return counters[FRAMES].get() % FRAME_SAMPLE == 0; }
+    void frame(int instructions){
+        counters[INSTRUCTIONS].add(instructions);
+        counters[FRAMES].add(1);
+    }
+    void draw(const chip8 &c, bool collision){
+        counters[DRAWS].add(1);
+        counters[COLLISIONS].add(collision);
+        if(key_time && c.gfx_hash != key_gfx_hash){
+            input_latency.record(metrics_now_ns() - key_time);
+            key_time = 0;
+        }
+    }
+    void keys_changed(const chip8 &c){
+        if(!key_time){ // the oldest change not shown yet
+            key_time = metrics_now_ns();
+            key_gfx_hash = c.gfx_hash;
+        }
+    }
+    // Forget a key change still waiting for its draw; call when the block moves to a new machine,
+    // or that machine's first draw would be timed against the old one's key.
+    void reset_pending(){ key_time = 0; }
+
+private:
+    metrics_registry &registry;
+    uint64_t key_time = 0; // writer only
+    uint64_t key_gfx_hash = 0;
+};
+
+struct metrics_snapshot {
+    struct vm {
+        std::string name;
+        uint64_t counters[vm_metrics::COUNT] = {};
+        histogram_data frame_time, input_latency;
+    };
+    std::vector<vm> vms; // live machines
+    vm total;            // live machines plus every machine that has gone away
+};
+
+class metrics_registry {
+public:
+    metrics_snapshot snapshot();
+
+private:
+    friend class vm_metrics;
+    std::mutex m;
+    std::vector<vm_metrics *> live;
+    metrics_snapshot::vm retired;
+};
+
+std::string metrics_json(const metrics_snapshot &s);
+std::string metrics_prometheus(const metrics_snapshot &s);
+std::string metrics_json_string(const std::string &s); // quoted, with " and \ escaped and control characters dropped
+// JSON if path ends in .json, Prometheus text otherwise; written to a temporary file and
+// renamed, as the node exporter's textfile collector expects. false (errno set) on I/O errors.
+bool write_metrics_file(const std::string &path, const metrics_snapshot &s);
+
+#endif //CHIP8_EMULATOR_METRICS_H
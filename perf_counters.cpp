@@ -0,0 +1,91 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *perf_counters::name(int k){
+    static const char *const names[COUNT] = {"cycles", "instructions", "branch_misses", "l1d_misses"};
+    return names[k];
+}
+
+#ifdef __linux__
+
+static int open_counter(uint32_t type, uint64_t config){
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1; // allowed at perf_event_paranoid 2
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+perf_counters::perf_counters(){
+    const struct { uint32_t type; uint64_t config; } events[COUNT] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                             PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    };
+    for(int k=0;k<COUNT;k++){
+        fd[k] = open_counter(events[k].type, events[k].config);
+        available[k] = fd[k] >= 0;
+        if(fd[k] < 0 && !error)
+            error = errno;
+    }
+}
+
+perf_counters::~perf_counters(){
+    for(int k=0;k<COUNT;k++)
+        if(fd[k] >= 0)
+            close(fd[k]);
+}
+
+void perf_counters::start(){
+    for(int k=0;k<COUNT;k++){
+        if(fd[k] < 0)
+            continue;
+        ioctl(fd[k], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd[k], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perf_counters::stop(){
+    for(int k=0;k<COUNT;k++){
+        if(fd[k] < 0)
+            continue;
+        ioctl(fd[k], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t v = 0;
+        if(read(fd[k], &v, sizeof(v)) != sizeof(v)){
+            available[k] = false;
+            continue;
+        }
+        value[k] = v;
+    }
+}
+
+#else
+
+perf_counters::perf_counters(){ error = ENOSYS; }
+perf_counters::~perf_counters(){}
+void perf_counters::start(){}
+void perf_counters::stop(){}
+
+#endif
+
+bool perf_counters::any() const {
+    for(int k=0;k<COUNT;k++)
+        if(available[k])
+            return true;
+    return false;
+}
@@ -0,0 +1,32 @@
+#ifndef CHIP8_EMULATOR_PERF_COUNTERS_H
+#define CHIP8_EMULATOR_PERF_COUNTERS_H
+
+#include <cstdint>
+
+// Host hardware counters for the calling thread through Linux perf_event_open.
+// Each counter is opened on its own, so a host (or container) that refuses some of them
+// still reports the rest; `available[k]` says which ones are real. On other systems, or when
+// perf is not permitted at all, every counter is unavailable and start/stop are no-ops.
+class perf_counters {
+public:
+    enum counter { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, COUNT };
+    static const char *name(int k);
+
+    perf_counters();
+    ~perf_counters();
+    perf_counters(const perf_counters &) = delete;
+    perf_counters &operator=(const perf_counters &) = delete;
+
+    void start();
+    void stop();
+
+    bool any() const;
+    bool available[COUNT] = {};
+    uint64_t value[COUNT] = {}; // counts between the last start() and stop()
+    int error = 0;              // errno of the first counter that failed to open
+
+private:
+    int fd[COUNT] = {-1, -1, -1, -1};
+};
+
+#endif //CHIP8_EMULATOR_PERF_COUNTERS_H
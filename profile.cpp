@@ -0,0 +1,136 @@
+#include "profile.h"
+#include "disasm.h"
+
+#include <algorithm>
+#include <cstdio>
+
+guest_profiler::guest_profiler(){
+    nodes.push_back({0, 0, std::make_unique<uint64_t[]>(0x1000)}); // root: code outside any subroutine
+    row = nodes[0].counts.get();
+}
+
+// ROMs that call without ever returning grow the tree forever; every path costs a 32KB row
+static const size_t MAX_NODES = 1 << 10;
+
+uint32_t guest_profiler::child(uint32_t parent, uint16_t callee){
+    uint64_t key = (uint64_t)parent << 12 | callee;
+    auto it = children.find(key);
+    if(it != children.end())
+        return it->second;
+    if(nodes.size() >= MAX_NODES)
+        return parent; // stop splitting, later instructions are charged to the caller
+    uint32_t id = (uint32_t)nodes.size();
+    nodes.push_back({parent, callee, std::make_unique<uint64_t[]>(0x1000)});
+    children.emplace(key, id);
+    return id;
+}
+
+uint64_t guest_profiler::self(uint32_t n) const {
+    uint64_t sum = 0;
+    for(int pc=0;pc<0x1000;pc++)
+        sum += nodes[n].counts[pc];
+    return sum;
+}
+
+uint64_t guest_profiler::instructions() const {
+    uint64_t total = 0;
+    for(uint32_t n=0;n<nodes.size();n++)
+        total += self(n);
+    return total;
+}
+
+static const char *const class_names[16] = {
+    "0NNN CLS/RET/SYS", "1NNN JP", "2NNN CALL", "3XNN SE", "4XNN SNE", "5XY0 SE", "6XNN LD", "7XNN ADD",
+    "8XYN ALU", "9XY0 SNE", "ANNN LD I", "BNNN JP V0", "CXNN RND", "DXYN DRW", "EXNN SKP/SKNP", "FXNN misc"};
+
+bool guest_profiler::write_report(const std::string &path, const chip8 &c, int top) const {
+    FILE *f = fopen(path.c_str(), "w");
+    if(!f)
+        return false;
+    // fold the rows into totals per address, per opcode class and per call path
+    std::vector<uint64_t> pc_counts(0x1000), node_counts(nodes.size());
+    uint64_t class_counts[16] = {};
+    uint64_t total = 0;
+    for(uint32_t n=0;n<nodes.size();n++){
+        for(int pc=0;pc<0x1000;pc++)
+            pc_counts[pc] += nodes[n].counts[pc];
+        node_counts[n] = self(n);
+        total += node_counts[n];
+    }
+    for(int pc=0;pc<0x1000;pc++)
+        class_counts[c.memory[pc] >> 4] += pc_counts[pc];
+
+    double all = total ? (double)total : 1.0;
+    fprintf(f, "instructions %llu\n\n", (unsigned long long)total);
+
+    std::vector<uint16_t> pcs;
+    for(int pc=0;pc<0x1000;pc++)
+        if(pc_counts[pc])
+            pcs.push_back(pc);
+    std::sort(pcs.begin(), pcs.end(), [&pc_counts](uint16_t a, uint16_t b){ return pc_counts[a] > pc_counts[b]; });
+    fprintf(f, "top program addresses\n");
+    for(size_t i=0;i<pcs.size() && (int)i<top;i++){
+        uint16_t pc = pcs[i];
+        uint16_t opcode = c.memory[pc]<<8 | c.memory[(pc+1) & 0xFFF]; // as it is now
+        char text[32];
+        disassemble_chip8(opcode, text, sizeof(text));
+        fprintf(f, "  %03X  %04X  %-16s %12llu  %5.1f%%\n", pc, opcode, text,
+                (unsigned long long)pc_counts[pc], pc_counts[pc] * 100.0 / all);
+    }
+
+    fprintf(f, "\nopcode classes\n");
+    for(int k=0;k<16;k++)
+        if(class_counts[k])
+            fprintf(f, "  %-18s %12llu  %5.1f%%\n", class_names[k],
+                    (unsigned long long)class_counts[k], class_counts[k] * 100.0 / all);
+
+    // inclusive cost per call path (children always have larger ids than their parent),
+    // then per subroutine, skipping paths where the subroutine is already on the stack
+    std::vector<uint64_t> inclusive(node_counts);
+    for(size_t n=nodes.size()-1;n>0;n--)
+        inclusive[nodes[n].parent] += inclusive[n];
+    std::unordered_map<uint16_t, std::pair<uint64_t, uint64_t>> subs; // callee -> (self, inclusive)
+    for(size_t n=1;n<nodes.size();n++){
+        uint16_t callee = nodes[n].callee;
+        subs[callee].first += node_counts[n];
+        bool recursive = false;
+        for(uint32_t p=nodes[n].parent;p!=0;p=nodes[p].parent)
+            if(nodes[p].callee == callee)
+                recursive = true;
+        if(!recursive)
+            subs[callee].second += inclusive[n];
+    }
+    std::vector<std::pair<uint16_t, std::pair<uint64_t, uint64_t>>> sorted(subs.begin(), subs.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b){ return a.second.second > b.second.second; });
+    fprintf(f, "\ntop subroutines            self                 inclusive\n");
+    for(size_t i=0;i<sorted.size() && (int)i<top;i++)
+        fprintf(f, "  sub_%03X  %12llu %5.1f%%  %12llu %5.1f%%\n", sorted[i].first,
+                (unsigned long long)sorted[i].second.first, sorted[i].second.first * 100.0 / all,
+                (unsigned long long)sorted[i].second.second, sorted[i].second.second * 100.0 / all);
+
+    bool ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    return ok;
+}
+
+bool guest_profiler::write_folded(const std::string &path) const {
+    FILE *f = fopen(path.c_str(), "w");
+    if(!f)
+        return false;
+    std::vector<uint16_t> stack;
+    for(uint32_t n=0;n<nodes.size();n++){
+        uint64_t count = self(n);
+        if(!count)
+            continue;
+        stack.clear();
+        for(uint32_t p=(uint32_t)n;p!=0;p=nodes[p].parent)
+            stack.push_back(nodes[p].callee);
+        fprintf(f, "main");
+        for(auto it=stack.rbegin();it!=stack.rend();++it)
+            fprintf(f, ";sub_%03X", *it);
+        fprintf(f, " %llu\n", (unsigned long long)count);
+    }
+    bool ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    return ok;
+}
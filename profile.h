@@ -0,0 +1,73 @@
+#ifndef CHIP8_EMULATOR_PROFILE_H
+#define CHIP8_EMULATOR_PROFILE_H
+
+#include "chip8.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Guest hot-spot profiler.
+//
+// Attach with `c.profile = &prof` (after intitialize_chip8). Every instruction is one increment:
+// its program address in the row of counts of the current call path. The call path is a node in
+// a tree of 2NNN call sites that only moves on 2NNN / 00EE. Totals per address, per call path
+// and per opcode class are summed from the rows when a report is written; the class of an
+// address is taken from the opcode there at that time.
+class guest_profiler {
+public:
+    guest_profiler();
+
+    // called by emulateCyle_chip8 with the opcode it is about to run
+    void count(const chip8 &c, uint16_t opcode){
+        row[c.PC & 0xFFF]++;
+        // the call/return itself is charged to the caller
+        if((opcode & 0xF000) == 0x2000) [[unlikely]]
+            call(opcode & 0x0FFF);
+        else if(opcode == 0x00EE) [[unlikely]]
+            ret();
+    }
+
+    // Human readable report: top PCs, opcode classes, top subroutines (self / inclusive).
+    bool write_report(const std::string &path, const chip8 &c, int top = 20) const;
+    // One line per call path, "main;sub_2A0;sub_300 <instructions>", for flamegraph.pl & co.
+    bool write_folded(const std::string &path) const;
+
+    uint64_t instructions() const;
+
+private:
+    struct node {
+        uint32_t parent;
+        uint16_t callee; // subroutine entry, 0 for the root
+        std::unique_ptr<uint64_t[]> counts; // per program address, self instructions of this path
+    };
+    uint32_t child(uint32_t parent, uint16_t callee); // parent itself once the tree is full
+    void enter(uint32_t n){
+        current = n;
+        row = nodes[n].counts.get();
+    }
+    void call(uint16_t callee){
+        uint32_t n = child(current, callee);
+        if(n == current) // no node for it, charged to the caller until the matching return
+            capped++;
+        else
+            enter(n);
+    }
+    void ret(){
+        if(capped)
+            capped--;
+        else
+            enter(nodes[current].parent);
+    }
+    uint64_t self(uint32_t n) const; // instructions of one call path
+
+    std::vector<node> nodes;
+    std::unordered_map<uint64_t, uint32_t> children; // (parent << 12 | callee) -> node
+    uint32_t current = 0;
+    uint32_t capped = 0; // calls without a node of their own still to return
+    uint64_t *row; // nodes[current].counts
+};
+
+#endif //CHIP8_EMULATOR_PROFILE_H
@@ -0,0 +1,293 @@
+#include "recorder.h"
+
+#include <cstring>
+
+static const size_t FRAME_BYTES = 32 * 8;
+static const size_t MAX_PAYLOAD = FRAME_BYTES + 64;
+
+static size_t put_varint(uint8_t *out, uint64_t v){
+    size_t n = 0;
+    while(v >= 0x80){
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool get_varint(const uint8_t *in, size_t n, size_t &pos, uint64_t &v){
+    v = 0;
+    for(int shift=0;shift<64;shift+=7){
+        if(pos >= n)
+            return false;
+        uint8_t b = in[pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if(!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void frame_bytes(const uint64_t rows[32], uint8_t out[FRAME_BYTES]){
+    for(int y=0;y<32;y++)
+        for(int b=0;b<8;b++)
+            out[y*8 + b] = (uint8_t)(rows[y] >> (56 - b*8)); // leftmost pixels first
+}
+
+size_t rle_encode_frame(const uint64_t rows[32], uint8_t *out){
+    uint8_t bytes[FRAME_BYTES];
+    frame_bytes(rows, bytes);
+    size_t n = 0;
+    size_t i = 0;
+    while(i < FRAME_BYTES){
+        size_t zeros = 0;
+        while(i + zeros < FRAME_BYTES && bytes[i + zeros] == 0)
+            zeros++;
+        i += zeros;
+        // a literal ends at the first run of two zero bytes, single zeros are cheaper inline
+        size_t lit = 0;
+        while(i + lit < FRAME_BYTES &&
+              !(bytes[i + lit] == 0 && (i + lit + 1 == FRAME_BYTES || bytes[i + lit + 1] == 0)))
+            lit++;
+        n += put_varint(out + n, zeros);
+        n += put_varint(out + n, lit);
+        memcpy(out + n, bytes + i, lit);
+        n += lit;
+        i += lit;
+    }
+    return n;
+}
+
+bool rle_decode_frame(const uint8_t *in, size_t n, uint64_t rows[32]){
+    uint8_t bytes[FRAME_BYTES];
+    size_t pos = 0;
+    size_t i = 0;
+    while(pos < n){
+        uint64_t zeros, lit;
+        if(!get_varint(in, n, pos, zeros) || !get_varint(in, n, pos, lit))
+            return false;
+        if(zeros > FRAME_BYTES - i || lit > FRAME_BYTES - i - zeros || lit > n - pos)
+            return false;
+        memset(bytes + i, 0, zeros);
+        i += zeros;
+        memcpy(bytes + i, in + pos, lit);
+        i += lit;
+        pos += lit;
+    }
+    if(i != FRAME_BYTES)
+        return false;
+    for(int y=0;y<32;y++){
+        uint64_t row = 0;
+        for(int b=0;b<8;b++)
+            row = row<<8 | bytes[y*8 + b];
+        rows[y] = row;
+    }
+    return true;
+}
+
+static void put_u16(uint8_t *p, uint16_t v){ p[0] = v; p[1] = v >> 8; }
+static void put_u32(uint8_t *p, uint32_t v){ for(int i=0;i<4;i++) p[i] = v >> (i*8); }
+static void put_u64(uint8_t *p, uint64_t v){ for(int i=0;i<8;i++) p[i] = v >> (i*8); }
+static uint16_t get_u16(const uint8_t *p){ return p[0] | p[1] << 8; }
+static uint32_t get_u32(const uint8_t *p){ uint32_t v = 0; for(int i=3;i>=0;i--) v = v<<8 | p[i]; return v; }
+static uint64_t get_u64(const uint8_t *p){ uint64_t v = 0; for(int i=7;i>=0;i--) v = v<<8 | p[i]; return v; }
+
+frame_recorder::~frame_recorder(){
+    close();
+}
+
+bool frame_recorder::open(const std::string &path, uint16_t interval, uint16_t fps){
+    close();
+    file = fopen(path.c_str(), "wb");
+    if(!file)
+        return false;
+    keyframe_interval = interval ? interval : 1;
+    memset(prev, 0, sizeof(prev));
+    frame_count = 0;
+    offset = 0;
+    index.clear();
+    uint8_t header[12];
+    put_u32(header, REC_MAGIC);
+    put_u16(header + 4, REC_VERSION);
+    put_u16(header + 6, keyframe_interval);
+    put_u16(header + 8, fps);
+    put_u16(header + 10, 0);
+    put(header, sizeof(header));
+    return true;
+}
+
+void frame_recorder::put(const void *p, size_t n){
+    fwrite(p, 1, n, file);
+    offset += n;
+}
+
+void frame_recorder::add(const uint64_t rows[32]){
+    if(!file)
+        return;
+    uint8_t record[1 + 2 + MAX_PAYLOAD];
+    uint8_t payload[MAX_PAYLOAD];
+    size_t n;
+    if(frame_count % keyframe_interval == 0){
+        index.emplace_back(frame_count, offset);
+        record[0] = 0;
+        n = rle_encode_frame(rows, payload);
+    }
+    else if(memcmp(rows, prev, sizeof(prev)) == 0){
+        record[0] = 2;
+        put(record, 1);
+        frame_count++;
+        return;
+    }
+    else{
+        uint64_t delta[32];
+        for(int y=0;y<32;y++)
+            delta[y] = rows[y] ^ prev[y];
+        record[0] = 1;
+        n = rle_encode_frame(delta, payload);
+    }
+    size_t h = 1 + put_varint(record + 1, n);
+    memcpy(record + h, payload, n);
+    put(record, h + n);
+    memcpy(prev, rows, sizeof(prev));
+    frame_count++;
+}
+
+void frame_recorder::skip(){
+    if(!file)
+        return;
+    if(frame_count % keyframe_interval == 0){ // keyframes stay where seek() expects them
+        uint64_t rows[32];
+        memcpy(rows, prev, sizeof(rows));
+        add(rows);
+        return;
+    }
+    uint8_t record = 2;
+    put(&record, 1);
+    frame_count++;
+}
+
+bool frame_recorder::close(){
+    if(!file)
+        return true;
+    uint64_t index_offset = offset;
+    uint8_t buf[20];
+    put_u32(buf, (uint32_t)index.size());
+    put(buf, 4);
+    for(auto &e : index){
+        put_u64(buf, e.first);
+        put_u64(buf + 8, e.second);
+        put(buf, 16);
+    }
+    put_u64(buf, index_offset);
+    put_u64(buf + 8, frame_count);
+    put_u32(buf + 16, REC_INDEX_MAGIC);
+    put(buf, 20);
+    bool ok = !ferror(file);
+    ok &= fclose(file) == 0;
+    file = nullptr;
+    return ok;
+}
+
+frame_reader::~frame_reader(){
+    if(file)
+        fclose(file);
+}
+
+bool frame_reader::open(const std::string &path){
+    if(file)
+        fclose(file);
+    file = fopen(path.c_str(), "rb");
+    if(!file)
+        return false;
+    uint8_t header[12];
+    if(fread(header, 1, sizeof(header), file) != sizeof(header) ||
+       get_u32(header) != REC_MAGIC || get_u16(header + 4) != REC_VERSION)
+        return false;
+    fps_ = get_u16(header + 8);
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    data_end = size;
+    index.clear();
+    frame_count = 0;
+    uint8_t footer[20];
+    if(size >= 12 + 24 && fseek(file, size - 20, SEEK_SET) == 0 &&
+       fread(footer, 1, 20, file) == 20 && get_u32(footer + 16) == REC_INDEX_MAGIC){
+        uint64_t index_offset = get_u64(footer);
+        frame_count = get_u64(footer + 8);
+        uint8_t count[4];
+        fseek(file, index_offset, SEEK_SET);
+        if(fread(count, 1, 4, file) == 4){
+            uint32_t n = get_u32(count);
+            for(uint32_t i=0;i<n;i++){
+                uint8_t e[16];
+                if(fread(e, 1, 16, file) != 16)
+                    break;
+                index.emplace_back(get_u64(e), get_u64(e + 8));
+            }
+            data_end = index_offset;
+        }
+    }
+    fseek(file, 12, SEEK_SET);
+    frame_no = 0;
+    memset(cur, 0, sizeof(cur));
+    return true;
+}
+
+bool frame_reader::next(uint64_t rows[32]){
+    if(!file || ftell(file) >= (long)data_end)
+        return false;
+    int type = fgetc(file);
+    if(type == 2){
+        memcpy(rows, cur, sizeof(cur));
+        frame_no++;
+        return true;
+    }
+    if(type != 0 && type != 1)
+        return false;
+    uint8_t len_bytes[10];
+    size_t pos = 0;
+    uint64_t len;
+    int b;
+    do{
+        b = fgetc(file);
+        if(b == EOF || pos == sizeof(len_bytes))
+            return false;
+        len_bytes[pos++] = (uint8_t)b;
+    } while(b & 0x80);
+    size_t p = 0;
+    if(!get_varint(len_bytes, pos, p, len) || len > MAX_PAYLOAD)
+        return false;
+    uint8_t payload[MAX_PAYLOAD];
+    uint64_t decoded[32];
+    if(fread(payload, 1, len, file) != len || !rle_decode_frame(payload, len, decoded))
+        return false;
+    for(int y=0;y<32;y++)
+        cur[y] = type == 0 ? decoded[y] : cur[y] ^ decoded[y];
+    memcpy(rows, cur, sizeof(cur));
+    frame_no++;
+    return true;
+}
+
+bool frame_reader::seek(uint64_t frame){
+    if(!file)
+        return false;
+    // start from the last keyframe at or before `frame` (or the beginning), then decode forward
+    uint64_t start_frame = 0, start_offset = 12;
+    for(auto &e : index){
+        if(e.first > frame)
+            break;
+        start_frame = e.first;
+        start_offset = e.second;
+    }
+    if(frame < frame_no || start_frame > frame_no){
+        fseek(file, start_offset, SEEK_SET);
+        frame_no = start_frame;
+        memset(cur, 0, sizeof(cur));
+    }
+    uint64_t rows[32];
+    while(frame_no < frame)
+        if(!next(rows))
+            return false;
+    return true;
+}
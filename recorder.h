@@ -0,0 +1,86 @@
+#ifndef CHIP8_EMULATOR_RECORDER_H
+#define CHIP8_EMULATOR_RECORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Screen recording format (.c8v), all integers little endian:
+ *
+ *   header   "C8RV" u32 | version u16 | keyframe interval u16 | fps u16 | reserved u16
+ *   frames   type u8 | payload length varint | payload
+ *              type 0 keyframe : RLE of the packed frame
+ *              type 1 delta    : RLE of the packed frame XOR the previous one
+ *              type 2 repeat   : no payload, same as the previous frame
+ *   index    count u32 | count x (frame number u64, file offset u64)   one entry per keyframe
+ *   footer   index offset u64 | frame count u64 | "C8RI" u32
+ *
+ * A packed frame is the 32 rows of pack_gfx_chip8 as 256 bytes. The RLE is a list of
+ * (zero run varint, literal length varint, literal bytes) covering all 256 bytes, so a delta
+ * where a sprite moved on a few rows is a handful of bytes. A file whose writer died before
+ * close() has no index/footer and is read by scanning the frames.
+ */
+
+#define REC_MAGIC 0x56523843u       // "C8RV"
+#define REC_INDEX_MAGIC 0x49523843u // "C8RI"
+#define REC_VERSION 1
+
+class frame_recorder {
+public:
+    frame_recorder() = default;
+    ~frame_recorder();
+    frame_recorder(const frame_recorder &) = delete;
+    frame_recorder &operator=(const frame_recorder &) = delete;
+
+    bool open(const std::string &path, uint16_t keyframe_interval = 600, uint16_t fps = 60);
+    bool is_open() const { return file != nullptr; }
+    void add(const uint64_t rows[32]); // append the next frame
+    void skip(); // append the next frame without encoding it: it repeats the previous one
+    bool close(); // write index and footer
+
+    uint64_t frames() const { return frame_count; }
+    uint64_t bytes() const { return offset; }
+
+private:
+    void put(const void *p, size_t n);
+
+    FILE *file = nullptr;
+    uint16_t keyframe_interval = 600;
+    uint64_t prev[32] = {};
+    uint64_t frame_count = 0;
+    uint64_t offset = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> index; // (frame, offset) of keyframes
+};
+
+class frame_reader {
+public:
+    frame_reader() = default;
+    ~frame_reader();
+    frame_reader(const frame_reader &) = delete;
+    frame_reader &operator=(const frame_reader &) = delete;
+
+    bool open(const std::string &path);
+    bool next(uint64_t rows[32]); // decode the next frame, false at the end
+    bool seek(uint64_t frame);    // position so next() returns `frame`
+
+    uint16_t fps() const { return fps_; }
+    uint64_t frames() const { return frame_count; } // 0 if the file has no index
+    uint64_t position() const { return frame_no; }
+
+private:
+    FILE *file = nullptr;
+    uint16_t fps_ = 60;
+    uint64_t data_end = 0; // offset of the index, or the file size without one
+    uint64_t frame_count = 0;
+    uint64_t frame_no = 0; // frame next() will return
+    uint64_t cur[32] = {};
+    std::vector<std::pair<uint64_t, uint64_t>> index;
+};
+
+// RLE helpers, exposed for tools that want to store packed frames elsewhere.
+size_t rle_encode_frame(const uint64_t rows[32], uint8_t *out); // out needs 256 + 64 bytes
+bool rle_decode_frame(const uint8_t *in, size_t n, uint64_t rows[32]);
+
+#endif //CHIP8_EMULATOR_RECORDER_H
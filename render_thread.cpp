@@ -0,0 +1,41 @@
+#include "render_thread.h"
+
+render_thread::render_thread(presenter present) : present(std::move(present)) {
+    worker = std::thread([this]{ run(); });
+}
+
+render_thread::~render_thread(){
+    stop();
+}
+
+void render_thread::submit(const chip8 &c, uint64_t frame_no){
+    packed_frame &f = frames.write_buffer();
+    f.frame_no = frame_no;
+    pack_gfx_chip8(c, f.rows);
+    frames.publish();
+    submitted.fetch_add(1, std::memory_order_release);
+    submitted.notify_one(); // only enters the kernel if the render thread is asleep
+}
+
+void render_thread::stop(){
+    if(!worker.joinable())
+        return;
+    stopping.store(true, std::memory_order_release);
+    submitted.fetch_add(1, std::memory_order_release);
+    submitted.notify_one();
+    worker.join();
+}
+
+void render_thread::run(){
+    uint32_t seen = 0;
+    for(;;){
+        submitted.wait(seen, std::memory_order_acquire);
+        seen = submitted.load(std::memory_order_acquire);
+        if(frames.update()){
+            present(frames.read_buffer());
+            presented_frames.fetch_add(1, std::memory_order_relaxed);
+        }
+        if(stopping.load(std::memory_order_acquire))
+            return;
+    }
+}
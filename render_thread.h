@@ -0,0 +1,47 @@
+#ifndef CHIP8_EMULATOR_RENDER_THREAD_H
+#define CHIP8_EMULATOR_RENDER_THREAD_H
+
+#include "chip8.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// One packed frame as handed to presenters.
+struct packed_frame {
+    uint64_t frame_no;
+    uint64_t rows[32]; // pack_gfx_chip8 layout
+};
+
+// Presents frames on its own thread so the emulation thread never waits for the display.
+// submit() packs the screen into the triple buffer and returns; the render thread wakes up,
+// takes the newest complete frame and calls the presenter with it. Frames submitted faster
+// than the presenter can draw are skipped, never queued.
+class render_thread {
+public:
+    using presenter = std::function<void(const packed_frame &)>;
+
+    explicit render_thread(presenter present);
+    ~render_thread();
+    render_thread(const render_thread &) = delete;
+    render_thread &operator=(const render_thread &) = delete;
+
+    void submit(const chip8 &c, uint64_t frame_no); // emulation thread only
+    void stop(); // present the last submitted frame and join
+
+    uint64_t presented() const { return presented_frames.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    presenter present;
+    triple_buffer<packed_frame> frames;
+    std::atomic<uint32_t> submitted{0}; // bumped per submit, the render thread waits on it
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> presented_frames{0};
+    std::thread worker;
+};
+
+#endif //CHIP8_EMULATOR_RENDER_THREAD_H
@@ -0,0 +1,165 @@
+#include "rom_bundle.h"
+#include "chip8.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+rom_bundle::~rom_bundle(){
+    close();
+}
+
+bool rom_bundle::open(const std::string &path){
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(rom_bundle_header)){
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+    size_t n = st.st_size;
+    void *p = mmap(nullptr, n, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED)
+        return false;
+
+    // check every offset once here, so lookups can trust the file; the checks subtract from
+    // bounds already checked and never add file values, so no crafted value can wrap them
+    const rom_bundle_header *h = (const rom_bundle_header *)p;
+    bool ok = h->magic == ROM_BUNDLE_MAGIC && h->version == ROM_BUNDLE_VERSION && h->size == n &&
+              h->toc_offset >= sizeof(rom_bundle_header) && h->toc_offset % alignof(rom_bundle_entry) == 0 &&
+              h->toc_offset <= h->names_offset && h->names_offset <= h->data_offset && h->data_offset <= n &&
+              h->count <= (h->names_offset - h->toc_offset) / sizeof(rom_bundle_entry);
+    const rom_bundle_entry *t = (const rom_bundle_entry *)((const uint8_t *)p + (ok ? h->toc_offset : 0));
+    const uint64_t names_size = ok ? h->data_offset - h->names_offset : 0;
+    for(uint32_t i=0;ok && i<h->count;i++){
+        ok = t[i].offset >= h->data_offset && t[i].offset <= n && t[i].size <= n - t[i].offset && t[i].size <= MAX &&
+             t[i].name_offset <= names_size && t[i].name_size <= names_size - t[i].name_offset &&
+             (i == 0 || t[i-1].hash <= t[i].hash);
+    }
+    if(!ok){
+        munmap(p, n);
+        errno = EINVAL;
+        return false;
+    }
+    base = (const uint8_t *)p;
+    size = n;
+    header = h;
+    toc = t;
+    return true;
+}
+
+void rom_bundle::close(){
+    if(base)
+        munmap((void *)base, size);
+    base = nullptr;
+    size = 0;
+    header = nullptr;
+    toc = nullptr;
+}
+
+rom_view rom_bundle::at(size_t i) const {
+    const rom_bundle_entry &e = toc[i];
+    return {base + e.offset, e.size, e.hash,
+            std::string_view((const char *)base + header->names_offset + e.name_offset, e.name_size)};
+}
+
+bool rom_bundle::find(uint64_t hash, rom_view &out) const {
+    const rom_bundle_entry *end = toc + count();
+    const rom_bundle_entry *e = std::lower_bound(toc, end, hash,
+                                                 [](const rom_bundle_entry &a, uint64_t h){ return a.hash < h; });
+    if(e == end || e->hash != hash)
+        return false;
+    out = at(e - toc);
+    return true;
+}
+
+bool rom_bundle::find(std::string_view name, rom_view &out) const {
+    for(size_t i=0;i<count();i++){
+        rom_view v = at(i);
+        if(v.name == name){
+            out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+void rom_bundle_writer::add(const std::string &name, const std::vector<uint8_t> &rom){
+    roms.push_back({name, rom, rom_hash_chip8(rom.data(), rom.size())});
+}
+
+bool rom_bundle_writer::write(const std::string &path) const {
+    std::vector<const item *> order;
+    for(const item &r : roms)
+        order.push_back(&r);
+    std::stable_sort(order.begin(), order.end(), [](const item *a, const item *b){ return a->hash < b->hash; });
+
+    rom_bundle_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ROM_BUNDLE_MAGIC;
+    h.version = ROM_BUNDLE_VERSION;
+    h.count = (uint32_t)order.size();
+    h.toc_offset = sizeof(h);
+    h.names_offset = h.toc_offset + order.size() * sizeof(rom_bundle_entry);
+
+    std::vector<rom_bundle_entry> toc(order.size());
+    std::string names;
+    for(size_t i=0;i<order.size();i++){
+        toc[i].hash = order[i]->hash;
+        toc[i].size = (uint32_t)order[i]->data.size();
+        toc[i].name_offset = (uint32_t)names.size();
+        toc[i].name_size = (uint32_t)order[i]->name.size();
+        names += order[i]->name;
+    }
+    h.data_offset = (h.names_offset + names.size() + 1) & ~1ull;
+
+    // blobs, identical ROMs share one copy
+    std::vector<uint8_t> data;
+    std::map<std::pair<uint64_t, uint32_t>, uint64_t> stored;
+    for(size_t i=0;i<order.size();i++){
+        const std::vector<uint8_t> &rom = order[i]->data;
+        auto key = std::make_pair(order[i]->hash, (uint32_t)rom.size());
+        auto it = stored.find(key);
+        if(it != stored.end() && memcmp(data.data() + (it->second - h.data_offset), rom.data(), rom.size()) == 0){
+            toc[i].offset = it->second;
+            continue;
+        }
+        toc[i].offset = h.data_offset + data.size();
+        stored[key] = toc[i].offset;
+        data.insert(data.end(), rom.begin(), rom.end());
+        if(data.size() & 1)
+            data.push_back(0); // keep every blob 2-byte aligned like instructions
+    }
+    h.size = h.data_offset + data.size();
+
+    std::string tmp = path + ".tmp" + std::to_string(getpid());
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if(!f)
+        return false;
+    static const uint8_t pad = 0;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    ok &= toc.empty() || fwrite(toc.data(), sizeof(rom_bundle_entry), toc.size(), f) == toc.size();
+    ok &= names.empty() || fwrite(names.data(), names.size(), 1, f) == 1;
+    if(h.data_offset > h.names_offset + names.size())
+        ok &= fwrite(&pad, 1, 1, f) == 1;
+    ok &= data.empty() || fwrite(data.data(), data.size(), 1, f) == 1;
+    ok &= fclose(f) == 0;
+    if(!ok || rename(tmp.c_str(), path.c_str()) != 0){
+        int err = errno;
+        remove(tmp.c_str());
+        errno = err;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef CHIP8_EMULATOR_ROM_BUNDLE_H
+#define CHIP8_EMULATOR_ROM_BUNDLE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Many ROMs in one file, mapped read-only so every worker on a host shares one page cache copy.
+ *
+ *   header | table of contents (sorted by hash) | names | ROM blobs (2-byte aligned)
+ *
+ * Entries are found by index, by rom_hash_chip8 (binary search) or by name. A rom_view points
+ * straight into the mapping and can be handed to intitialize_chip8 as is. Identical ROMs are
+ * stored once and share a blob.
+ */
+
+#define ROM_BUNDLE_MAGIC 0x42523843u // "C8RB"
+#define ROM_BUNDLE_VERSION 1
+
+struct rom_bundle_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t toc_offset;
+    uint64_t names_offset;
+    uint64_t data_offset;
+    uint64_t size; // whole file
+};
+
+struct rom_bundle_entry {
+    uint64_t hash;        // rom_hash_chip8 of the ROM
+    uint64_t offset;      // of the ROM bytes, from the start of the file
+    uint32_t size;
+    uint32_t name_offset; // from names_offset
+    uint32_t name_size;
+    uint32_t reserved;
+};
+
+struct rom_view {
+    const uint8_t *data;
+    uint32_t size;
+    uint64_t hash;
+    std::string_view name;
+};
+
+class rom_bundle {
+public:
+    rom_bundle() = default;
+    ~rom_bundle();
+    rom_bundle(const rom_bundle &) = delete;
+    rom_bundle &operator=(const rom_bundle &) = delete;
+
+    bool open(const std::string &path); // false (errno set) if missing or malformed
+    void close();
+
+    size_t count() const { return header ? header->count : 0; }
+    rom_view at(size_t i) const;
+    bool find(uint64_t hash, rom_view &out) const;
+    bool find(std::string_view name, rom_view &out) const; // linear scan
+
+private:
+    const uint8_t *base = nullptr;
+    size_t size = 0;
+    const rom_bundle_header *header = nullptr;
+    const rom_bundle_entry *toc = nullptr;
+};
+
+// Collects ROMs in memory and writes a bundle.
+class rom_bundle_writer {
+public:
+    void add(const std::string &name, const std::vector<uint8_t> &rom);
+    bool write(const std::string &path) const; // false (errno set) on I/O errors
+    size_t count() const { return roms.size(); }
+
+private:
+    struct item {
+        std::string name;
+        std::vector<uint8_t> data;
+        uint64_t hash;
+    };
+    std::vector<item> roms;
+};
+
+#endif //CHIP8_EMULATOR_ROM_BUNDLE_H
@@ -0,0 +1,137 @@
+#include "shm_export.h"
+
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+shm_frame_writer::~shm_frame_writer(){
+    close();
+}
+
+bool shm_frame_writer::create(const std::string &shm_name, uint32_t slots){
+    close();
+    if(slots == 0)
+        return false;
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0644);
+    if(fd < 0)
+        return false;
+    size = sizeof(shm_frame_header) + slots * sizeof(shm_frame_slot);
+    if(ftruncate(fd, size) != 0){
+        ::close(fd);
+        shm_unlink(shm_name.c_str());
+        return false;
+    }
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+        shm_unlink(shm_name.c_str());
+        return false;
+    }
+    name = shm_name;
+    header = new (p) shm_frame_header;
+    slot = reinterpret_cast<shm_frame_slot *>(header + 1);
+    for(uint32_t i=0;i<slots;i++)
+        new (&slot[i]) shm_frame_slot{};
+    header->version = SHM_FRAME_VERSION;
+    header->slots = slots;
+    header->slot_size = sizeof(shm_frame_slot);
+    header->published.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_FRAME_MAGIC; // readers check this last
+    frame_no = 0;
+    return true;
+}
+
+void shm_frame_writer::publish(const chip8 &c){
+    if(!header)
+        return;
+    shm_frame_slot &s = slot[frame_no % header->slots];
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed); // odd: slot is being written
+    std::atomic_thread_fence(std::memory_order_release);
+    s.frame_no = frame_no;
+    s.hash = frame_hash_chip8(c);
+    pack_gfx_chip8(c, s.rows);
+    s.seq.store(seq + 2, std::memory_order_release);
+    header->published.store(++frame_no, std::memory_order_release);
+}
+
+void shm_frame_writer::close(){
+    if(!header)
+        return;
+    munmap(header, size);
+    shm_unlink(name.c_str());
+    header = nullptr;
+    slot = nullptr;
+}
+
+shm_frame_reader::~shm_frame_reader(){
+    close();
+}
+
+bool shm_frame_reader::open(const std::string &name){
+    close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shm_frame_header)){
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED)
+        return false;
+    size = st.st_size;
+    header = static_cast<const shm_frame_header *>(p);
+    if(header->magic != SHM_FRAME_MAGIC || header->version != SHM_FRAME_VERSION ||
+       header->slot_size != sizeof(shm_frame_slot) ||
+       size < sizeof(shm_frame_header) + header->slots * sizeof(shm_frame_slot)){
+        close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    slot = reinterpret_cast<const shm_frame_slot *>(header + 1);
+    return true;
+}
+
+uint64_t shm_frame_reader::published() const {
+    return header ? header->published.load(std::memory_order_acquire) : 0;
+}
+
+bool shm_frame_reader::read_latest(uint64_t rows[32], uint64_t *frame_no, uint64_t *hash) const {
+    if(!header)
+        return false;
+    for(;;){
+        uint64_t n = header->published.load(std::memory_order_acquire);
+        if(n == 0)
+            return false;
+        const shm_frame_slot &s = slot[(n - 1) % header->slots];
+        uint32_t before = s.seq.load(std::memory_order_acquire);
+        if(before & 1)
+            continue; // writer is inside this slot, it has moved on to a newer frame
+        uint64_t no = s.frame_no;
+        uint64_t h = s.hash;
+        memcpy(rows, s.rows, sizeof(s.rows));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(s.seq.load(std::memory_order_relaxed) != before)
+            continue; // overwritten while copying
+        if(frame_no)
+            *frame_no = no;
+        if(hash)
+            *hash = h;
+        return true;
+    }
+}
+
+void shm_frame_reader::close(){
+    if(!header)
+        return;
+    munmap(const_cast<shm_frame_header *>(header), size);
+    header = nullptr;
+    slot = nullptr;
+}
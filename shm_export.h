@@ -0,0 +1,81 @@
+#ifndef CHIP8_EMULATOR_SHM_EXPORT_H
+#define CHIP8_EMULATOR_SHM_EXPORT_H
+
+#include "chip8.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * Framebuffer export through POSIX shared memory.
+ *
+ * The emulator (single writer) publishes packed frames into a ring of slots in a shm object,
+ * any number of local processes map it read-only. Every slot is guarded by a sequence counter
+ * (seqlock): odd while the writer is inside the slot, even once the frame is complete. The writer
+ * never waits for readers; a reader that raced the writer sees the counter change and retries.
+ *
+ *   header | slot 0 | slot 1 | ... | slot n-1      (each on its own cache lines)
+ */
+
+#define SHM_FRAME_MAGIC 0x38504843u // "CHP8"
+#define SHM_FRAME_VERSION 1
+
+struct alignas(64) shm_frame_slot {
+    std::atomic<uint32_t> seq;
+    uint32_t reserved;
+    uint64_t frame_no;
+    uint64_t hash;     // frame_hash_chip8 of the frame
+    uint64_t rows[32]; // pack_gfx_chip8 layout
+};
+
+struct alignas(64) shm_frame_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_size;
+    std::atomic<uint64_t> published; // frames published so far, newest is in slot (published-1) % slots
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "atomics shared between processes must be lock free");
+
+class shm_frame_writer {
+public:
+    shm_frame_writer() = default;
+    ~shm_frame_writer();
+    shm_frame_writer(const shm_frame_writer &) = delete;
+    shm_frame_writer &operator=(const shm_frame_writer &) = delete;
+
+    bool create(const std::string &name, uint32_t slots = 8); // name like "/chip8-0"
+    void publish(const chip8 &c); // pack the screen straight into the next slot
+    void close();
+
+private:
+    std::string name;
+    shm_frame_header *header = nullptr;
+    shm_frame_slot *slot = nullptr;
+    size_t size = 0;
+    uint64_t frame_no = 0;
+};
+
+class shm_frame_reader {
+public:
+    shm_frame_reader() = default;
+    ~shm_frame_reader();
+    shm_frame_reader(const shm_frame_reader &) = delete;
+    shm_frame_reader &operator=(const shm_frame_reader &) = delete;
+
+    bool open(const std::string &name);
+    // Copy out the newest complete frame. False if nothing was published yet.
+    bool read_latest(uint64_t rows[32], uint64_t *frame_no = nullptr, uint64_t *hash = nullptr) const;
+    uint64_t published() const;
+    void close();
+
+private:
+    const shm_frame_header *header = nullptr;
+    const shm_frame_slot *slot = nullptr;
+    size_t size = 0;
+};
+
+#endif //CHIP8_EMULATOR_SHM_EXPORT_H
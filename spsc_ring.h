@@ -0,0 +1,60 @@
+#ifndef CHIP8_EMULATOR_SPSC_RING_H
+#define CHIP8_EMULATOR_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free single producer / single consumer ring buffer.
+// Neither side ever waits: push() stores what fits and returns how much that was, pop() takes
+// what is available. Capacity is rounded up to a power of two.
+template <class T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity){
+        size_t n = 1;
+        while(n < capacity)
+            n <<= 1;
+        buffer.resize(n);
+        mask = n - 1;
+    }
+
+    size_t capacity() const { return buffer.size(); }
+
+    // producer side
+    size_t push(const T *items, size_t n){
+        size_t w = write_pos.load(std::memory_order_relaxed);
+        size_t r = read_pos.load(std::memory_order_acquire);
+        size_t space = buffer.size() - (w - r);
+        if(n > space)
+            n = space;
+        for(size_t i=0;i<n;i++)
+            buffer[(w + i) & mask] = items[i];
+        write_pos.store(w + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer side
+    size_t pop(T *items, size_t n){
+        size_t r = read_pos.load(std::memory_order_relaxed);
+        size_t w = write_pos.load(std::memory_order_acquire);
+        if(n > w - r)
+            n = w - r;
+        for(size_t i=0;i<n;i++)
+            items[i] = buffer[(r + i) & mask];
+        read_pos.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t size() const {
+        return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> buffer;
+    size_t mask;
+    alignas(64) std::atomic<size_t> write_pos{0};
+    alignas(64) std::atomic<size_t> read_pos{0};
+};
+
+#endif //CHIP8_EMULATOR_SPSC_RING_H
@@ -0,0 +1,52 @@
+#include "term_keyboard.h"
+
+#include <unistd.h>
+
+term_keyboard::term_keyboard(int fd, int hold) : fd(fd), hold(hold) {
+    if(!isatty(fd) || tcgetattr(fd, &saved) != 0)
+        return;
+    termios t = saved;
+    t.c_lflag &= ~(ICANON | ECHO | ISIG);
+    t.c_cc[VMIN] = 0; // read() returns at once with whatever is there
+    t.c_cc[VTIME] = 0;
+    raw = tcsetattr(fd, TCSANOW, &t) == 0;
+}
+
+term_keyboard::~term_keyboard(){
+    if(raw)
+        tcsetattr(fd, TCSANOW, &saved);
+}
+
+static int keypad(char ch){
+    static const char layout[] = "x123qweasdzc4rfv"; // host key of each CHIP-8 key 0..F
+    if(ch >= 'A' && ch <= 'Z')
+        ch += 'a' - 'A';
+    for(int k=0;k<16;k++)
+        if(layout[k] == ch)
+            return k;
+    return -1;
+}
+
+uint16_t term_keyboard::poll(){
+    for(int k=0;k<16;k++)
+        if(remaining[k] > 0)
+            remaining[k]--;
+    if(raw){
+        char buf[64];
+        ssize_t n;
+        while((n = read(fd, buf, sizeof(buf))) > 0){
+            for(ssize_t i=0;i<n;i++){
+                if(buf[i] == 0x03)
+                    quit = true;
+                int k = keypad(buf[i]);
+                if(k >= 0)
+                    remaining[k] = hold;
+            }
+        }
+    }
+    uint16_t mask = 0;
+    for(int k=0;k<16;k++)
+        if(remaining[k] > 0)
+            mask |= 1 << k;
+    return mask;
+}
@@ -0,0 +1,35 @@
+#ifndef CHIP8_EMULATOR_TERM_KEYBOARD_H
+#define CHIP8_EMULATOR_TERM_KEYBOARD_H
+
+#include <cstdint>
+#include <termios.h>
+
+// Keypad input from a terminal in raw mode, polled once per frame without blocking.
+//
+//   1 2 3 4        1 2 3 C
+//   q w e r   ->   4 5 6 D
+//   a s d f        7 8 9 E
+//   z x c v        A 0 B F
+//
+// Terminals only report presses, so a key counts as down for `hold` frames after its last
+// press; the terminal's auto-repeat keeps a held key down. Ctrl-C sets `quit`.
+class term_keyboard {
+public:
+    explicit term_keyboard(int fd = 0, int hold = 8);
+    ~term_keyboard(); // restores the terminal
+    term_keyboard(const term_keyboard &) = delete;
+    term_keyboard &operator=(const term_keyboard &) = delete;
+
+    bool active() const { return raw; } // false when fd is not a terminal
+    uint16_t poll();                    // key bitmask for the next frame
+    bool quit = false;
+
+private:
+    int fd;
+    int hold;
+    bool raw = false;
+    termios saved;
+    int remaining[16] = {};
+};
+
+#endif //CHIP8_EMULATOR_TERM_KEYBOARD_H
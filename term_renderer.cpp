@@ -0,0 +1,79 @@
+#include "term_renderer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+// glyph for a cell, index = top pixel | bottom pixel << 1
+static const char *const glyphs[4] = {" ", "▀", "▄", "█"};
+static const int glyph_len[4] = {1, 3, 3, 3};
+
+// Worst case frame: every cell changed plus a cursor move per row, plus clear/hide sequences.
+static const size_t FRAME_BUFFER = 16 * (64 * 3 + 16) + 32;
+
+static void write_all(int fd, const char *p, size_t n){
+    while(n > 0){
+        ssize_t w = ::write(fd, p, n);
+        if(w <= 0)
+            return; // terminal went away, nothing sensible left to do
+        p += w;
+        n -= w;
+    }
+}
+
+term_renderer::term_renderer(int fd) : fd(fd) {}
+
+term_renderer::~term_renderer(){
+    if(!painted)
+        return;
+    const char restore[] = "\x1b[17;1H\x1b[?25h"; // below the screen, show cursor
+    write_all(fd, restore, sizeof(restore) - 1);
+}
+
+void term_renderer::present(const packed_frame &f){
+    char out[FRAME_BUFFER];
+    char *p = out;
+    if(!painted){
+        p += sprintf(p, "\x1b[?25l\x1b[2J"); // hide cursor, clear
+        memset(shadow, 0, sizeof(shadow));
+    }
+
+    for(int cy=0;cy<16;cy++){
+        uint64_t top = f.rows[cy*2];
+        uint64_t bottom = f.rows[cy*2+1];
+        // a blank terminal after the clear matches an all zero shadow, but the cells still
+        // need writing once so every later diff is against what is really on screen
+        uint64_t changed = (top ^ shadow[cy*2]) | (bottom ^ shadow[cy*2+1]);
+        if(painted && !changed)
+            continue;
+        if(!painted)
+            changed = ~0ull;
+        shadow[cy*2] = top;
+        shadow[cy*2+1] = bottom;
+
+        auto emit = [&](int x){
+            int g = (int)(top >> (63 - x) & 1) | (int)(bottom >> (63 - x) & 1) << 1;
+            memcpy(p, glyphs[g], glyph_len[g]);
+            p += glyph_len[g];
+        };
+        int cursor = -1; // column the terminal cursor is at, -1 = unknown
+        for(int x=0;x<64;x++){
+            if(!(changed >> (63 - x) & 1))
+                continue;
+            if(cursor >= 0 && x - cursor <= 2){
+                // rewriting a short unchanged gap is cheaper than a cursor move
+                for(;cursor<x;cursor++)
+                    emit(cursor);
+            }
+            else if(cursor != x)
+                p += sprintf(p, "\x1b[%d;%dH", cy + 1, x + 1);
+            emit(x);
+            cursor = x + 1;
+        }
+    }
+    painted = true;
+    if(p != out){
+        write_all(fd, out, p - out);
+        bytes += p - out;
+    }
+}
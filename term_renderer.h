@@ -0,0 +1,28 @@
+#ifndef CHIP8_EMULATOR_TERM_RENDERER_H
+#define CHIP8_EMULATOR_TERM_RENDERER_H
+
+#include "render_thread.h"
+
+#include <cstdint>
+
+// Draws the 64x32 screen on an ANSI terminal as 64x16 cells, each cell holding two pixel rows
+// as a Unicode half block. The last frame sent is kept as a shadow copy and only cells that
+// differ from it are written (cursor move + glyphs), all of it in a single write() per frame,
+// so an idle screen costs nothing and a moving sprite a few dozen bytes.
+class term_renderer {
+public:
+    explicit term_renderer(int fd = 1);
+    ~term_renderer(); // shows the cursor again and moves it below the screen
+
+    void present(const packed_frame &f);
+
+    uint64_t bytes_written() const { return bytes; }
+
+private:
+    int fd;
+    bool painted = false; // false until the first full frame is on the terminal
+    uint64_t shadow[32] = {};
+    uint64_t bytes = 0;
+};
+
+#endif //CHIP8_EMULATOR_TERM_RENDERER_H
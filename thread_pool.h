@@ -0,0 +1,81 @@
+#ifndef CHIP8_EMULATOR_THREAD_POOL_H
+#define CHIP8_EMULATOR_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from one queue.
+// Tasks may submit more tasks; wait() returns once the queue is empty and every task has finished.
+class thread_pool {
+public:
+    explicit thread_pool(unsigned threads = std::thread::hardware_concurrency()){
+        if(threads == 0)
+            threads = 1;
+        for(unsigned i=0;i<threads;i++)
+            workers.emplace_back([this]{ work(); });
+    }
+
+    ~thread_pool(){
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        task_ready.notify_all();
+        for(auto &t : workers)
+            t.join();
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    void submit(std::function<void()> task){
+        {
+            std::lock_guard<std::mutex> lock(m);
+            tasks.push_back(std::move(task));
+            pending++;
+        }
+        task_ready.notify_one();
+    }
+
+    void wait(){
+        std::unique_lock<std::mutex> lock(m);
+        all_done.wait(lock, [this]{ return pending == 0; });
+    }
+
+private:
+    void work(){
+        for(;;){
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                task_ready.wait(lock, [this]{ return stopping || !tasks.empty(); });
+                if(tasks.empty())
+                    return; // stopping and nothing left to run
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if(--pending == 0)
+                    all_done.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex m;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    size_t pending = 0; // queued + running
+    bool stopping = false;
+};
+
+#endif //CHIP8_EMULATOR_THREAD_POOL_H
@@ -0,0 +1,32 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../analyze.h"
+#include "../chip8.h"
+
+// usage: Chip8_analyze <rom.ch8> [--text | --dot | --json]
+int main(int argc, char **argv) {
+    if(argc < 2)
+    {
+        std::cerr<<"usage: "<<argv[0]<<" <rom.ch8> [--text | --dot | --json]\n";
+        return 1;
+    }
+    std::vector<uint8_t> program;
+    if(!load_rom_chip8(argv[1], program))
+    {
+        std::cerr<<"Fail to read complete file";
+        return 1;
+    }
+    std::string format = argc > 2 ? argv[2] : "--text";
+
+    rom_analysis a = analyze_rom_chip8(program.data(), program.size());
+    if(format == "--dot")
+        std::cout<<analysis_dot(a);
+    else if(format == "--json")
+        std::cout<<analysis_json(a);
+    else
+        std::cout<<analysis_text(a);
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../chip8.h"
+#include "../decode.h"
+#include "../metrics.h"
+#include "../perf_counters.h"
+#include "../profile.h"
+#include "../rom_bundle.h"
+#include "../trace.h"
+
+// End to end ROM benchmark: runs each ROM on each engine for a fixed number of guest
+// instructions and reports wall time plus host perf counters per guest instruction.
+//
+// usage: Chip8_bench [--instructions N] [--repeat N] [--engine NAME]... [--json] [--bundle FILE] rom.ch8...
+
+namespace {
+
+// Attachments owned by one benchmark run.
+struct attachments {
+    std::unique_ptr<trace_ring> trace;
+    std::unique_ptr<guest_profiler> profile;
+    std::unique_ptr<decoded_program> decoded;
+    std::unique_ptr<vm_metrics> metrics;
+};
+
+// An engine is the core run with a given set of attachments.
+struct engine {
+    const char *name;
+    void (*attach)(chip8 &c, attachments &a);
+};
+
+const engine engines[] = {
+    {"interpreter", [](chip8 &, attachments &){}},
+    {"fused", [](chip8 &c, attachments &a){
+        if(!a.decoded)
+            a.decoded = std::make_unique<decoded_program>();
+        decode_program_chip8(*a.decoded, c);
+        c.decoded = a.decoded.get();
+    }},
+    {"metrics", [](chip8 &c, attachments &a){ // fused with counters and frame timing on
+        if(!a.decoded)
+            a.decoded = std::make_unique<decoded_program>();
+        decode_program_chip8(*a.decoded, c);
+        c.decoded = a.decoded.get();
+        if(!a.metrics)
+            a.metrics = std::make_unique<vm_metrics>("bench");
+        a.metrics->reset_pending();
+        c.metrics = a.metrics.get();
+    }},
+    {"trace", [](chip8 &c, attachments &a){
+        a.trace = std::make_unique<trace_ring>();
+        c.trace = a.trace.get();
+    }},
+    {"profile", [](chip8 &c, attachments &a){
+        a.profile = std::make_unique<guest_profiler>();
+        c.profile = a.profile.get();
+    }},
+};
+
+struct result {
+    std::string rom;
+    const char *engine;
+    uint64_t instructions;
+    double seconds;
+    bool available[perf_counters::COUNT];
+    uint64_t value[perf_counters::COUNT];
+};
+
+const int CYCLES_PER_FRAME = 10;
+
+result run(const engine &e, const std::string &rom, const uint8_t *program, size_t size, uint64_t instructions, int repeat){
+    static chip8 c;
+    result best{rom, e.name, instructions, 1e30, {}, {}};
+    for(int r=0;r<repeat;r++){
+        attachments a;
+        intitialize_chip8(c, program, size);
+        e.attach(c, a);
+        perf_counters counters;
+
+        auto start = std::chrono::steady_clock::now();
+        counters.start();
+        uint64_t done = 0;
+        for(uint64_t frame=0;done<instructions;frame++){
+            // walk the keypad slowly so ROMs waiting on input keep moving
+            memset(c.key, 0, sizeof(c.key));
+            if(frame & 8)
+                c.key[(frame >> 4) & 0xF] = 1;
+            int retired;
+            if(!run_frame_chip8(c, CYCLES_PER_FRAME, retired)){
+                intitialize_chip8(c, program, size); // halted, start over
+                e.attach(c, a);
+            }
+            done += retired;
+        }
+        counters.stop();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if(seconds < best.seconds){
+            best.seconds = seconds;
+            best.instructions = done;
+            for(int k=0;k<perf_counters::COUNT;k++){
+                best.available[k] = counters.available[k];
+                best.value[k] = counters.value[k];
+            }
+        }
+    }
+    return best;
+}
+
+void print_text(const std::vector<result> &results){
+    printf("%-24s %-12s %10s %10s", "rom", "engine", "MIPS", "ns/instr");
+    for(int k=0;k<perf_counters::COUNT;k++)
+        printf(" %14s", perf_counters::name(k));
+    printf("   (host counters per guest instruction)\n");
+    for(const result &r : results){
+        printf("%-24s %-12s %10.1f %10.2f", r.rom.c_str(), r.engine,
+               r.instructions / r.seconds / 1e6, r.seconds * 1e9 / r.instructions);
+        for(int k=0;k<perf_counters::COUNT;k++)
+            if(r.available[k])
+                printf(" %14.3f", (double)r.value[k] / r.instructions);
+            else
+                printf(" %14s", "n/a");
+        printf("\n");
+    }
+}
+
+void print_json(const std::vector<result> &results, int perf_error){
+    printf("{\n  \"perf_error\": ");
+    if(perf_error)
+        printf("\"%s\",\n", strerror(perf_error));
+    else
+        printf("null,\n");
+    printf("  \"results\": [\n");
+    for(size_t i=0;i<results.size();i++){
+        const result &r = results[i];
+        printf("    {\"rom\": %s, \"engine\": \"%s\", \"guest_instructions\": %llu, \"seconds\": %.6f, \"mips\": %.3f",
+               metrics_json_string(r.rom).c_str(), r.engine, (unsigned long long)r.instructions, r.seconds, r.instructions / r.seconds / 1e6);
+        for(int k=0;k<perf_counters::COUNT;k++){
+            if(r.available[k])
+                printf(", \"%s\": {\"total\": %llu, \"per_guest_instruction\": %.6f}", perf_counters::name(k),
+                       (unsigned long long)r.value[k], (double)r.value[k] / r.instructions);
+            else
+                printf(", \"%s\": null", perf_counters::name(k));
+        }
+        printf("}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    uint64_t instructions = 10000000;
+    int repeat = 3;
+    bool json = false;
+    std::vector<const engine *> selected;
+    std::vector<std::string> roms;
+    rom_bundle bundle;
+    for(int i=1;i<argc;i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--instructions" && i+1 < argc)
+            instructions = std::strtoull(argv[++i], nullptr, 0);
+        else if(arg == "--repeat" && i+1 < argc)
+            repeat = std::atoi(argv[++i]);
+        else if(arg == "--json")
+            json = true;
+        else if(arg == "--engine" && i+1 < argc)
+        {
+            std::string name = argv[++i];
+            bool found = false;
+            for(const engine &e : engines)
+                if(name == e.name)
+                {
+                    selected.push_back(&e);
+                    found = true;
+                }
+            if(!found)
+            {
+                std::cerr<<"unknown engine "<<name<<"\n";
+                return 1;
+            }
+        }
+        else if(arg == "--bundle" && i+1 < argc)
+        {
+            if(!bundle.open(argv[++i]))
+            {
+                std::cerr<<"Fail to open "<<argv[i]<<": "<<strerror(errno)<<"\n";
+                return 1;
+            }
+        }
+        else if(arg[0] != '-')
+            roms.push_back(arg);
+        else
+        {
+            std::cerr<<"usage: "<<argv[0]<<" [--instructions N] [--repeat N] [--engine NAME]... [--json] [--bundle FILE] rom.ch8...\n";
+            return 1;
+        }
+    }
+    if(roms.empty() && !bundle.count())
+        roms.push_back("../test.ch8");
+    if(selected.empty())
+        for(const engine &e : engines)
+            selected.push_back(&e);
+    if(repeat < 1)
+        repeat = 1;
+
+    perf_counters probe;
+    if(!probe.any() && !json)
+        std::cerr<<"host counters unavailable ("<<strerror(probe.error)<<"), reporting wall time only\n";
+
+    std::vector<result> results;
+    for(const std::string &rom : roms)
+    {
+        std::vector<uint8_t> program;
+        if(!load_rom_chip8(rom, program))
+        {
+            std::cerr<<"Fail to read "<<rom<<"\n";
+            return 1;
+        }
+        for(const engine *e : selected)
+            results.push_back(run(*e, rom, program.data(), program.size(), instructions, repeat));
+    }
+    for(size_t i=0;i<bundle.count();i++) // straight from the mapping
+    {
+        rom_view rom = bundle.at(i);
+        for(const engine *e : selected)
+            results.push_back(run(*e, std::string(rom.name), rom.data, rom.size, instructions, repeat));
+    }
+
+    if(json)
+        print_json(results, probe.any() ? 0 : probe.error);
+    else
+        print_text(results);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../chip8.h"
+#include "../explore.h"
+
+// usage: Chip8_explore <rom.ch8> [max_states] [threads] [cycles_per_frame]
+int main(int argc, char **argv) {
+    if(argc < 2)
+    {
+        std::cerr<<"usage: "<<argv[0]<<" <rom.ch8> [max_states] [threads] [cycles_per_frame]\n";
+        return 1;
+    }
+    std::vector<uint8_t> program;
+    if(!load_rom_chip8(argv[1], program))
+    {
+        std::cerr<<"Fail to read complete file";
+        return 1;
+    }
+
+    explore_options opt;
+    if(argc > 2)
+        opt.max_states = std::strtoull(argv[2], nullptr, 0);
+    if(argc > 3)
+        opt.threads = std::strtoul(argv[3], nullptr, 0);
+    if(argc > 4)
+        opt.cycles_per_frame = std::strtoul(argv[4], nullptr, 0);
+
+    static chip8 root;
+    intitialize_chip8(root, program.data(), program.size());
+
+    auto start = std::chrono::steady_clock::now();
+    explore_stats s = explore_chip8(root, opt);
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+    std::cout<<"states        "<<s.states<<"\n"
+             <<"duplicates    "<<s.duplicates<<"\n"
+             <<"branch points "<<s.branch_points<<"\n"
+             <<"halted        "<<s.halted<<"\n"
+             <<"exhausted     "<<s.exhausted<<"\n"
+             <<"truncated     "<<s.truncated<<"\n"
+             <<"instructions  "<<s.instructions<<"\n"
+             <<"time          "<<took.count()<<" s\n";
+    return 0;
+}
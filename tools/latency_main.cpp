@@ -0,0 +1,350 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../chip8.h"
+#include "../decode.h"
+#include "../input_log.h"
+#include "../metrics.h"
+#include "../render_thread.h"
+#include "../term_renderer.h"
+
+// Keypress-to-pixel latency: an injector thread presses keys at random host times, the emulation
+// loop picks the keypad up at its next frame boundary as main.cpp does with term_keyboard, and a
+// press is timed until the first frame whose screen depends on it has been presented through
+// term_renderer (written to /dev/null) and until the refresh of a simulated 60Hz display that
+// shows it. The frame that depends on a press is found by running a shadow copy of the machine
+// that never sees it: the first frame where the two presented screens differ.
+//
+// Each combination of the listed settings is one configuration:
+//   render   inline (present on the emulation thread) or thread (render_thread)
+//   runahead frames run ahead speculatively with the current keys before presenting; the real
+//            machine stays behind, so the speculative frames are redone with the next input
+//   pacing   free (a 60Hz clock of its own, as main.cpp) or late (start each frame --margin ms
+//            before the display refresh)
+//
+// usage: Chip8_latency [--presses N] [--cycles N] [--render LIST] [--runahead LIST] [--pacing LIST]
+//                      [--margin MS] [--seed N] [--json] [rom.ch8]
+
+namespace {
+
+using host_clock = std::chrono::steady_clock;
+const auto FRAME = std::chrono::nanoseconds(16666667); // 60Hz, for both the emulator and the display
+const uint64_t NONE = ~0ull;
+const int GIVE_UP = 120; // frames after a press without a dependent change
+
+struct config {
+    bool thread;
+    int runahead;
+    bool late;
+
+    std::string name() const {
+        return std::string(thread ? "thread" : "inline") + " runahead=" + std::to_string(runahead) + (late ? " late" : " free");
+    }
+};
+
+struct result {
+    config cfg;
+    int presses = 0;
+    int no_effect = 0;  // no screen change within GIVE_UP frames
+    int overlapped = 0; // pressed while the previous press was still being timed
+    histogram_data present, visible;
+};
+
+uint64_t ns(host_clock::time_point t){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+// A copy that shares none of the source's attachments; it runs on the plain interpreter.
+void detached_copy(chip8 &dst, const chip8 &src){
+    dst = src;
+    dst.trace = nullptr;
+    dst.profile = nullptr;
+    dst.decoded = nullptr;
+    dst.shared = nullptr;
+    dst.debug = nullptr;
+    dst.metrics = nullptr;
+}
+
+// The machine whose screen is presented: m itself, or a copy run `runahead` frames further.
+const chip8 &output(const chip8 &m, chip8 &ahead, const config &cfg, int cycles){
+    if(!cfg.runahead)
+        return m;
+    detached_copy(ahead, m);
+    for(int r=0;r<cfg.runahead;r++)
+        run_frame_chip8(ahead, cycles);
+    return ahead;
+}
+
+// Presses one key at a time from its own thread, like a keyboard driver would.
+class injector {
+public:
+    injector(int presses, uint32_t seed) : worker([this, presses, seed]{ run(presses, seed); }) {}
+    ~injector(){ worker.join(); }
+
+    uint16_t keys() const { return mask.load(std::memory_order_acquire); }
+    uint64_t press_ns() const { return pressed_at.load(std::memory_order_relaxed); } // of the last press in keys()
+    bool done() const { return finished.load(std::memory_order_acquire); }
+
+private:
+    void run(int presses, uint32_t seed){
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> gap_us(150000, 350000); // random phase against the frames
+        std::uniform_int_distribution<int> key(0, 15);
+        for(int p=0;p<presses;p++){
+            std::this_thread::sleep_for(std::chrono::microseconds(gap_us(rng)));
+            pressed_at.store(ns(host_clock::now()), std::memory_order_relaxed);
+            mask.store((uint16_t)(1 << key(rng)), std::memory_order_release);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            mask.store(0, std::memory_order_release);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200)); // let the last press show
+        finished.store(true, std::memory_order_release);
+    }
+
+    std::atomic<uint16_t> mask{0};
+    std::atomic<uint64_t> pressed_at{0};
+    std::atomic<bool> finished{false};
+    std::thread worker;
+};
+
+result run(const config &cfg, const std::vector<uint8_t> &program, int presses, int cycles, int margin_us, uint32_t seed, int fd){
+    result r;
+    r.cfg = cfg;
+    static chip8 real, shadow, ahead, shadow_ahead;
+    intitialize_chip8(real, program.data(), program.size());
+    decoded_program decoded;
+    decode_program_chip8(decoded, real);
+    real.decoded = &decoded;
+
+    // The simulated display refreshes every FRAME from a random phase; a presented frame becomes
+    // visible at the next refresh.
+    std::mt19937 rng(seed);
+    auto start = host_clock::now();
+    uint64_t display0 = ns(start) + std::uniform_int_distribution<uint64_t>(0, FRAME.count() - 1)(rng);
+    auto visible_at = [display0](uint64_t t){
+        uint64_t period = FRAME.count();
+        return t <= display0 ? display0 : display0 + (t - display0 + period - 1) / period * period;
+    };
+
+    // The frame that first shows the press being timed, handed to whichever thread presents.
+    // The emulation thread sets it, the presenting thread clears it once that frame is out.
+    std::atomic<uint64_t> target_frame{NONE};
+    std::atomic<uint64_t> target_press{0};
+    latency_histogram present_latency, visible_latency; // presenting thread only
+    term_renderer terminal(fd);
+    auto present = [&](const packed_frame &f){
+        terminal.present(f);
+        if(f.frame_no < target_frame.load(std::memory_order_acquire))
+            return;
+        uint64_t now = ns(host_clock::now());
+        uint64_t pressed = target_press.load(std::memory_order_relaxed);
+        present_latency.record(now - pressed);
+        visible_latency.record(visible_at(now) - pressed);
+        target_frame.store(NONE, std::memory_order_release);
+    };
+    std::unique_ptr<render_thread> renderer;
+    if(cfg.thread)
+        renderer = std::make_unique<render_thread>(present);
+
+    injector keyboard(presses, seed);
+    uint16_t last_keys = 0;
+    uint16_t probe_key = 0; // the press the shadow machine does not see, 0 = not shadowing
+    uint64_t probe_press = 0, probe_frame = 0;
+    auto next_frame = start;
+    if(cfg.late)
+        next_frame += std::chrono::nanoseconds(visible_at(ns(start)) - ns(start)) - std::chrono::microseconds(margin_us);
+    for(uint64_t frame=0;;frame++){
+        std::this_thread::sleep_until(next_frame);
+        next_frame += FRAME;
+        if(keyboard.done() && !probe_key && target_frame.load(std::memory_order_acquire) == NONE)
+            break;
+
+        uint16_t keys = keyboard.keys();
+        uint16_t pressed = keys & ~last_keys;
+        if(pressed){
+            r.presses++;
+            if(probe_key || target_frame.load(std::memory_order_acquire) != NONE)
+                r.overlapped++;
+            else{
+                probe_key = pressed;
+                probe_press = keyboard.press_ns();
+                probe_frame = frame;
+                detached_copy(shadow, real); // forked before the press is seen
+            }
+        }
+        last_keys = keys;
+        set_keys_chip8(real, keys);
+        bool running = run_frame_chip8(real, cycles);
+        const chip8 &shown = output(real, ahead, cfg, cycles);
+
+        if(probe_key){
+            set_keys_chip8(shadow, keys & ~probe_key);
+            run_frame_chip8(shadow, cycles);
+            const chip8 &counterfactual = output(shadow, shadow_ahead, cfg, cycles);
+            if(memcmp(shown.gfx, counterfactual.gfx, sizeof(shown.gfx)) != 0){
+                target_press.store(probe_press, std::memory_order_relaxed);
+                target_frame.store(frame, std::memory_order_release);
+                probe_key = 0;
+            }
+            else if(frame - probe_frame >= GIVE_UP){
+                r.no_effect++;
+                probe_key = 0;
+            }
+        }
+
+        if(renderer)
+            renderer->submit(shown, frame);
+        else{
+            packed_frame f;
+            f.frame_no = frame;
+            pack_gfx_chip8(shown, f.rows);
+            present(f);
+        }
+        if(!running){
+            std::cerr<<"the program halted after "<<frame + 1<<" frames\n";
+            break;
+        }
+    }
+    if(renderer)
+        renderer->stop();
+    r.present.add(present_latency);
+    r.visible.add(visible_latency);
+    return r;
+}
+
+bool parse_list(const char *arg, std::vector<int> &out, int (*value)(const std::string &)){
+    out.clear();
+    std::stringstream in(arg);
+    std::string item;
+    while(std::getline(in, item, ',')){
+        int v = value(item);
+        if(v < 0)
+            return false;
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+double ms(uint64_t ns){ return ns / 1e6; }
+
+void print_text(const std::vector<result> &results){
+    printf("%-28s %7s %9s %9s   %-37s   %s\n", "configuration", "presses", "no_effect", "overlap",
+           "presented ms: p50   p90   p99   max", "visible ms: p50   p90   p99   max");
+    for(const result &r : results){
+        printf("%-28s %7d %9d %9d   %14.1f %5.1f %5.1f %5.1f   %14.1f %5.1f %5.1f %5.1f\n", r.cfg.name().c_str(),
+               r.presses, r.no_effect, r.overlapped,
+               ms(r.present.quantile(0.5)), ms(r.present.quantile(0.9)), ms(r.present.quantile(0.99)), ms(r.present.largest),
+               ms(r.visible.quantile(0.5)), ms(r.visible.quantile(0.9)), ms(r.visible.quantile(0.99)), ms(r.visible.largest));
+    }
+}
+
+std::string json_latency(const histogram_data &h){
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+             (unsigned long long)h.total, (unsigned long long)(h.total ? h.sum / h.total : 0),
+             (unsigned long long)h.quantile(0.5), (unsigned long long)h.quantile(0.9),
+             (unsigned long long)h.quantile(0.99), (unsigned long long)h.largest);
+    return buf;
+}
+
+void print_json(const std::vector<result> &results){
+    printf("{\n  \"results\": [\n");
+    for(size_t i=0;i<results.size();i++){
+        const result &r = results[i];
+        printf("    {\"render\": \"%s\", \"runahead\": %d, \"pacing\": \"%s\", \"presses\": %d, \"no_effect\": %d, \"overlapped\": %d,\n"
+               "     \"presented\": %s,\n     \"visible\": %s}%s\n",
+               r.cfg.thread ? "thread" : "inline", r.cfg.runahead, r.cfg.late ? "late" : "free", r.presses, r.no_effect,
+               r.overlapped, json_latency(r.present).c_str(), json_latency(r.visible).c_str(), i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string rom = "../test.ch8";
+    int presses = 50;
+    int cycles = 10;
+    int margin_us = 3000;
+    uint32_t seed = 1;
+    bool json = false;
+    std::vector<int> renders = {0, 1}, runaheads = {0}, pacings = {0};
+    for(int i=1;i<argc;i++)
+    {
+        std::string arg = argv[i];
+        bool ok = true;
+        if(arg == "--presses" && i+1 < argc)
+            presses = std::atoi(argv[++i]);
+        else if(arg == "--cycles" && i+1 < argc)
+            cycles = std::atoi(argv[++i]);
+        else if(arg == "--margin" && i+1 < argc)
+            margin_us = (int)(std::atof(argv[++i]) * 1000);
+        else if(arg == "--seed" && i+1 < argc)
+            seed = (uint32_t)std::strtoul(argv[++i], nullptr, 0);
+        else if(arg == "--json")
+            json = true;
+        else if(arg == "--render" && i+1 < argc)
+            ok = parse_list(argv[++i], renders, [](const std::string &s){ return s == "inline" ? 0 : s == "thread" ? 1 : -1; });
+        else if(arg == "--runahead" && i+1 < argc)
+            ok = parse_list(argv[++i], runaheads, [](const std::string &s){
+                return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos ? std::atoi(s.c_str()) : -1;
+            });
+        else if(arg == "--pacing" && i+1 < argc)
+            ok = parse_list(argv[++i], pacings, [](const std::string &s){ return s == "free" ? 0 : s == "late" ? 1 : -1; });
+        else if(arg[0] != '-')
+            rom = arg;
+        else
+            ok = false;
+        if(!ok)
+        {
+            std::cerr<<"usage: "<<argv[0]<<" [--presses N] [--cycles N] [--render inline,thread] [--runahead 0,1,...]"
+                     <<" [--pacing free,late] [--margin MS] [--seed N] [--json] [rom.ch8]\n";
+            return 1;
+        }
+    }
+    if(presses < 1 || cycles < 1 || margin_us < 0 || margin_us >= FRAME.count() / 1000)
+    {
+        std::cerr<<"--presses and --cycles must be positive and --margin below a frame\n";
+        return 1;
+    }
+
+    std::vector<uint8_t> program;
+    if(!load_rom_chip8(rom, program))
+    {
+        std::cerr<<"Fail to read "<<rom<<"\n";
+        return 1;
+    }
+
+    int fd = open("/dev/null", O_WRONLY); // the terminal output is produced, just not shown
+    std::vector<result> results;
+    for(int pacing : pacings)
+        for(int runahead : runaheads)
+            for(int render : renders)
+            {
+                config cfg{render != 0, runahead, pacing != 0};
+                if(!json)
+                    std::cerr<<"measuring "<<cfg.name()<<" ("<<presses<<" presses)\n";
+                results.push_back(run(cfg, program, presses, cycles, margin_us, seed, fd));
+            }
+
+    close(fd);
+
+    if(json)
+        print_json(results);
+    else
+        print_text(results);
+    return 0;
+}
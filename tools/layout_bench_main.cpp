@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../chip8.h"
+
+// Fleet layout benchmark: T threads each run their share of M machines from one contiguous
+// array. "blocked" gives every thread a contiguous range, "interleaved" hands out machine i to
+// thread i % T, so every pair of neighbours in memory belongs to two different threads. With
+// a layout that lets neighbours share a cache line the interleaved run collapses from false
+// sharing; with the chip8 layout (whole aligned lines per machine) both runs match.
+//
+// This file is built twice: Chip8_layout on the cache line layout of chip8.h and
+// Chip8_layout_naive on a core built with CHIP8_NAIVE_LAYOUT (fields in their original order,
+// no alignment or padding). Chip8_layout runs Chip8_layout_naive from its own directory with the
+// same arguments after its own runs, so one invocation reports both layouts.
+//
+// usage: Chip8_layout [--threads N] [--machines N] [--frames N] [--this-layout] [rom.ch8]
+
+namespace {
+
+#ifdef CHIP8_NAIVE_LAYOUT
+const char *LAYOUT = "naive";
+#else
+const char *LAYOUT = "aligned";
+#endif
+const int CYCLES_PER_FRAME = 10;
+
+double run(std::vector<chip8> &machines, const std::vector<uint8_t> &program, unsigned threads, int frames, bool interleaved){
+    for(size_t i=0;i<machines.size();i++){
+        intitialize_chip8(machines[i], program.data(), program.size(), (uint32_t)i + 1);
+        machines[i].key[i & 0xF] = 1; // keep ROMs waiting on a key moving
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(unsigned t=0;t<threads;t++)
+        workers.emplace_back([&, t]{
+            size_t n = machines.size();
+            for(int f=0;f<frames;f++){
+                if(interleaved)
+                    for(size_t i=t;i<n;i+=threads)
+                        run_frame_chip8(machines[i], CYCLES_PER_FRAME);
+                else
+                    for(size_t i=n*t/threads;i<n*(t+1)/threads;i++)
+                        run_frame_chip8(machines[i], CYCLES_PER_FRAME);
+            }
+        });
+    for(std::thread &w : workers)
+        w.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (double)machines.size() * frames * CYCLES_PER_FRAME / seconds / 1e6;
+}
+
+// Runs the naive build next to this binary with the same arguments, output straight to ours.
+void run_naive(char **argv){
+    std::string self = argv[0];
+    size_t slash = self.rfind('/');
+    std::string path = (slash == std::string::npos ? std::string(".") : self.substr(0, slash)) + "/Chip8_layout_naive";
+    std::vector<char *> args = {path.data()};
+    for(int i=1;argv[i];i++)
+        args.push_back(argv[i]);
+    std::string only = "--this-layout";
+    args.push_back(only.data());
+    args.push_back(nullptr);
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0){
+        execv(path.c_str(), args.data());
+        _exit(127);
+    }
+    int status = 0;
+    if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        std::cerr<<"could not run "<<path<<", naive layout not measured\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    size_t count = 0;
+    int frames = 2000;
+    std::string rom = "../test.ch8";
+    bool this_layout = false;
+    for(int i=1;i<argc;i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--threads" && i+1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if(arg == "--machines" && i+1 < argc)
+            count = std::strtoull(argv[++i], nullptr, 0);
+        else if(arg == "--frames" && i+1 < argc)
+            frames = std::atoi(argv[++i]);
+        else if(arg == "--this-layout")
+            this_layout = true;
+        else if(arg[0] != '-')
+            rom = arg;
+        else
+        {
+            std::cerr<<"usage: "<<argv[0]<<" [--threads N] [--machines N] [--frames N] [--this-layout] [rom.ch8]\n";
+            return 1;
+        }
+    }
+    if(threads == 0)
+        threads = 1;
+    if(count == 0)
+        count = threads * 64;
+
+    std::vector<uint8_t> program;
+    if(!load_rom_chip8(rom, program))
+    {
+        std::cerr<<"Fail to read "<<rom<<"\n";
+        return 1;
+    }
+
+    if(!this_layout)
+        printf("%u threads, %zu machines, %d frames of %d instructions\n", threads, count, frames, CYCLES_PER_FRAME);
+    printf("%s layout: sizeof(chip8) %zu, alignof %zu, PC at %zu, V at %zu, memory at %zu, gfx at %zu\n", LAYOUT,
+           sizeof(chip8), alignof(chip8), offsetof(chip8, PC), offsetof(chip8, V), offsetof(chip8, memory), offsetof(chip8, gfx));
+
+    std::vector<chip8> machines(count);
+    double blocked = run(machines, program, threads, frames, false);
+    double interleaved = run(machines, program, threads, frames, true);
+    printf("  %-12s %10.1f MIPS\n", "blocked", blocked);
+    printf("  %-12s %10.1f MIPS  (%.2fx of blocked)\n", "interleaved", interleaved, interleaved / blocked);
+    if(!this_layout)
+        run_naive(argv);
+    return 0;
+}
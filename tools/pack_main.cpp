@@ -0,0 +1,72 @@
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../chip8.h"
+#include "../rom_bundle.h"
+
+// Pack ROMs into a bundle (rom_bundle.h). Directories are searched recursively for *.ch8.
+//
+// usage: Chip8_pack out.c8b rom.ch8|dir...
+//        Chip8_pack --list bundle.c8b
+
+namespace fs = std::filesystem;
+
+int main(int argc, char **argv) {
+    if(argc < 3)
+    {
+        std::cerr<<"usage: "<<argv[0]<<" out.c8b rom.ch8|dir...\n"
+                 <<"       "<<argv[0]<<" --list bundle.c8b\n";
+        return 1;
+    }
+    if(std::string(argv[1]) == "--list")
+    {
+        rom_bundle bundle;
+        if(!bundle.open(argv[2]))
+        {
+            std::cerr<<"Fail to open "<<argv[2]<<": "<<strerror(errno)<<"\n";
+            return 1;
+        }
+        for(size_t i=0;i<bundle.count();i++)
+        {
+            rom_view r = bundle.at(i);
+            printf("%016llx %5u %.*s\n", (unsigned long long)r.hash, r.size, (int)r.name.size(), r.name.data());
+        }
+        return 0;
+    }
+
+    std::vector<fs::path> paths;
+    for(int i=2;i<argc;i++)
+    {
+        std::error_code ec;
+        if(fs::is_directory(argv[i], ec))
+        {
+            for(const fs::directory_entry &e : fs::recursive_directory_iterator(argv[i], ec))
+                if(e.is_regular_file() && e.path().extension() == ".ch8")
+                    paths.push_back(e.path());
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+
+    rom_bundle_writer writer;
+    for(const fs::path &p : paths)
+    {
+        std::vector<uint8_t> program;
+        if(!load_rom_chip8(p.string(), program))
+        {
+            std::cerr<<"skipping "<<p.string()<<" (unreadable or larger than "<<MAX<<" bytes)\n";
+            continue;
+        }
+        writer.add(p.filename().string(), program);
+    }
+    if(!writer.write(argv[1]))
+    {
+        std::cerr<<"Fail to write "<<argv[1]<<": "<<strerror(errno)<<"\n";
+        return 1;
+    }
+    std::cerr<<writer.count()<<" ROMs packed into "<<argv[1]<<"\n";
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../recorder.h"
+#include "../upscale.h"
+
+// usage: Chip8_rec2video <in.c8v> <out.ppm|out.y4m> [--scale N] [--frame N]
+//   .ppm writes one frame (default: the first), .y4m writes every frame as greyscale video.
+int main(int argc, char **argv) {
+    if(argc < 3)
+    {
+        std::cerr<<"usage: "<<argv[0]<<" <in.c8v> <out.ppm|out.y4m> [--scale N] [--frame N]\n";
+        return 1;
+    }
+    std::string in = argv[1], out = argv[2];
+    int scale = 10;
+    uint64_t frame = 0;
+    for(int i=3;i+1<argc;i+=2)
+    {
+        if(!strcmp(argv[i], "--scale"))
+            scale = std::atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "--frame"))
+            frame = std::strtoull(argv[i+1], nullptr, 0);
+    }
+    if(scale < 1)
+        scale = 1;
+
+    frame_reader reader;
+    if(!reader.open(in))
+    {
+        std::cerr<<"Fail to open recording "<<in<<"\n";
+        return 1;
+    }
+    FILE *f = fopen(out.c_str(), "wb");
+    if(!f)
+    {
+        std::cerr<<"Fail to create "<<out<<"\n";
+        return 1;
+    }
+
+    const int w = 64 * scale, h = 32 * scale;
+    std::vector<uint32_t> pixels((size_t)w * h);
+    uint64_t rows[32];
+    bool y4m = out.size() > 4 && out.compare(out.size() - 4, 4, ".y4m") == 0;
+
+    if(!y4m)
+    {
+        if(!reader.seek(frame) || !reader.next(rows))
+        {
+            std::cerr<<"No frame "<<frame<<" in "<<in<<"\n";
+            return 1;
+        }
+        upscale_rgba(rows, pixels.data(), w, scale, 0x000000, 0xFFFFFF);
+        fprintf(f, "P6\n%d %d\n255\n", w, h);
+        std::vector<uint8_t> rgb((size_t)w * h * 3);
+        for(size_t i=0;i<pixels.size();i++)
+        {
+            rgb[i*3] = pixels[i] >> 16;
+            rgb[i*3+1] = pixels[i] >> 8;
+            rgb[i*3+2] = pixels[i];
+        }
+        fwrite(rgb.data(), 1, rgb.size(), f);
+        fclose(f);
+        return 0;
+    }
+
+    // 4:2:0 with neutral chroma, what every y4m consumer accepts
+    fprintf(f, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", w, h, reader.fps());
+    std::vector<uint8_t> luma((size_t)w * h);
+    std::vector<uint8_t> chroma((size_t)((w + 1) / 2) * ((h + 1) / 2) * 2, 128);
+    uint64_t n = 0;
+    while(reader.next(rows))
+    {
+        upscale_rgba(rows, pixels.data(), w, scale, 16, 235); // video range luma
+        for(size_t i=0;i<pixels.size();i++)
+            luma[i] = (uint8_t)pixels[i];
+        fputs("FRAME\n", f);
+        fwrite(luma.data(), 1, luma.size(), f);
+        fwrite(chroma.data(), 1, chroma.size(), f);
+        n++;
+    }
+    fclose(f);
+    std::cerr<<n<<" frames written\n";
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../job_server.h"
+
+// Long running batch job server on a Unix domain socket (protocol in job_server.h).
+// SIGINT / SIGTERM stop accepting, let the queued jobs finish and remove the socket.
+//
+// usage: Chip8_server [--threads N] [--bundle FILE] socket_path
+//   e.g. echo "run id=1 rom=test.ch8 frames=60 want=gfx" | nc -U /tmp/chip8.sock
+
+static job_server *server;
+
+int main(int argc, char **argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    std::string bundle_path;
+    std::string socket_path;
+    for(int i=1;i<argc;i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--threads" && i+1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if(arg == "--bundle" && i+1 < argc)
+            bundle_path = argv[++i];
+        else if(arg[0] != '-' && socket_path.empty())
+            socket_path = arg;
+        else
+        {
+            socket_path.clear();
+            break;
+        }
+    }
+    if(socket_path.empty())
+    {
+        std::cerr<<"usage: "<<argv[0]<<" [--threads N] [--bundle FILE] socket_path\n";
+        return 1;
+    }
+
+    job_server s(threads);
+    if(!bundle_path.empty() && !s.open_bundle(bundle_path))
+    {
+        std::cerr<<"Fail to open "<<bundle_path<<": "<<strerror(errno)<<"\n";
+        return 1;
+    }
+    if(!s.listen(socket_path))
+    {
+        std::cerr<<"Fail to listen on "<<socket_path<<": "<<strerror(errno)<<"\n";
+        return 1;
+    }
+    server = &s;
+    std::signal(SIGINT, [](int){ server->stop(); });
+    std::signal(SIGTERM, [](int){ server->stop(); });
+    std::cerr<<"serving on "<<socket_path<<" with "<<(threads ? threads : 1)<<" workers\n";
+    s.serve();
+    std::cerr<<s.stats();
+    return 0;
+}
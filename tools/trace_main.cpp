@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "../disasm.h"
+#include "../trace.h"
+
+// usage: Chip8_trace <trace.c8t>
+// Prints a dumped execution trace as disassembly with the state each instruction changed.
+int main(int argc, char **argv) {
+    if(argc < 2)
+    {
+        std::cerr<<"usage: "<<argv[0]<<" <trace.c8t>\n";
+        return 1;
+    }
+    trace_decoder decoder;
+    if(!decoder.load(argv[1]))
+    {
+        std::cerr<<"Fail to read trace "<<argv[1]<<"\n";
+        return 1;
+    }
+
+    trace_record r;
+    while(decoder.next(r))
+    {
+        char text[32];
+        disassemble_chip8(r.opcode, text, sizeof(text));
+        printf("%10llu  %03X  %04X  %-16s", (unsigned long long)r.index, r.pc, r.opcode, text);
+        for(int k=0;k<16;k++)
+            if(r.v_mask & (1 << k))
+                printf(" V%X=%02X", k, r.v[k]);
+        if(r.flags & TRACE_I)
+            printf(" I=%03X", r.i);
+        if(r.flags & TRACE_MEM)
+        {
+            printf(" [%03X]=", r.mem_addr);
+            for(uint8_t b : r.mem)
+                printf("%02X", b);
+        }
+        if(r.flags & TRACE_SP)
+            printf(" SP=%u", r.sp);
+        if(r.flags & TRACE_TIMER)
+            printf(" DT=%02X ST=%02X", r.delay_timer, r.sound_timer);
+        if(r.flags & TRACE_FAULT)
+            printf("  <-- fault");
+        printf("\n");
+    }
+    return 0;
+}
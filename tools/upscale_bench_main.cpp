@@ -0,0 +1,168 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../chip8.h"
+#include "../upscale.h"
+
+// Checks upscale_rgba against upscale_rgba_scalar and times both.
+//
+// The check runs random frames (sparse, dense, all off / all on and frames with repeated rows, which
+// take the row reuse path) through every scale from 1 to past the SIMD limit, with random colours and
+// destination strides padded past 64*scale. Both outputs are written over the same canary fill and
+// compared whole, so writes into the padding count as mismatches too. Any mismatch exits with 2.
+//
+// The timing upscales the frames of a ROM run (--frames of them, --cycles per frame) at --scale,
+// 20 by default for 1280x640, and prints frames per second for each version.
+//
+// usage: Chip8_upscale [--frames N] [--cycles N] [--scale N] [--seconds S] [--checks N] [--seed N] [rom.ch8]
+
+namespace {
+
+using host_clock = std::chrono::steady_clock;
+const int MAX_CHECK_SCALE = 72; // past the 64 where upscale_rgba hands over to the scalar path
+const uint32_t CANARY = 0xDEADBEEF;
+
+void random_frame(std::mt19937 &rng, uint64_t rows[32]){
+    switch(rng() % 5){
+        case 0: // all off or all on
+        {
+            uint64_t v = rng() & 1 ? ~0ull : 0;
+            for(int y=0;y<32;y++)
+                rows[y] = v;
+            break;
+        }
+        case 1: // runs of repeated rows
+            for(int y=0;y<32;y++)
+                rows[y] = y && rng() % 3 ? rows[y-1] : ((uint64_t)rng() << 32 | rng());
+            break;
+        case 2: // sparse
+            for(int y=0;y<32;y++)
+                rows[y] = ((uint64_t)rng() << 32 | rng()) & ((uint64_t)rng() << 32 | rng()) & ((uint64_t)rng() << 32 | rng());
+            break;
+        default:
+            for(int y=0;y<32;y++)
+                rows[y] = (uint64_t)rng() << 32 | rng();
+            break;
+    }
+}
+
+// Returns false and reports the first differing pixel.
+bool check(int checks, uint32_t seed){
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> a, b;
+    uint64_t rows[32];
+    for(int i=0;i<checks;i++)
+    {
+        random_frame(rng, rows);
+        for(int scale=1;scale<=MAX_CHECK_SCALE;scale++)
+        {
+            size_t stride = 64*(size_t)scale + rng() % 10;
+            uint32_t off = rng(), on = rng() % 4 ? rng() : off;
+            a.assign(stride * (32*scale + 1), CANARY);
+            b.assign(a.size(), CANARY);
+            upscale_rgba(rows, a.data(), stride, scale, off, on);
+            upscale_rgba_scalar(rows, b.data(), stride, scale, off, on);
+            if(a == b)
+                continue;
+            size_t p = 0;
+            while(a[p] == b[p])
+                p++;
+            fprintf(stderr, "mismatch: frame %d scale %d stride %zu at x=%zu y=%zu: %08X, scalar %08X\n",
+                    i, scale, stride, p % stride, p / stride, a[p], b[p]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Frames per second of `fn` over `frames`, repeated for at least `seconds`.
+template<typename F>
+double time_frames(const std::vector<uint64_t> &frames, int scale, double seconds, F fn){
+    size_t stride = 64*(size_t)scale;
+    std::vector<uint32_t> dst(stride * 32*scale);
+    size_t n = frames.size() / 32;
+    uint64_t done = 0;
+    auto start = host_clock::now();
+    std::chrono::duration<double> elapsed{0};
+    do
+    {
+        for(size_t i=0;i<n;i++)
+            fn(&frames[i*32], dst.data(), stride, scale, 0xFF000000, 0xFFFFFFFF);
+        done += n;
+        elapsed = host_clock::now() - start;
+    } while(elapsed.count() < seconds);
+    return done / elapsed.count();
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::string rom = "../test.ch8";
+    int frames = 600;
+    int cycles = 10;
+    int scale = 20;
+    double seconds = 2;
+    int checks = 200;
+    uint32_t seed = 1;
+    for(int i=1;i<argc;i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--frames" && i+1 < argc)
+            frames = std::atoi(argv[++i]);
+        else if(arg == "--cycles" && i+1 < argc)
+            cycles = std::atoi(argv[++i]);
+        else if(arg == "--scale" && i+1 < argc)
+            scale = std::atoi(argv[++i]);
+        else if(arg == "--seconds" && i+1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if(arg == "--checks" && i+1 < argc)
+            checks = std::atoi(argv[++i]);
+        else if(arg == "--seed" && i+1 < argc)
+            seed = (uint32_t)std::strtoul(argv[++i], nullptr, 0);
+        else if(arg[0] != '-')
+            rom = arg;
+        else
+        {
+            std::cerr<<"usage: "<<argv[0]<<" [--frames N] [--cycles N] [--scale N] [--seconds S] [--checks N] [--seed N] [rom.ch8]\n";
+            return 1;
+        }
+    }
+    if(frames < 1 || scale < 1)
+    {
+        std::cerr<<"--frames and --scale must be at least 1\n";
+        return 1;
+    }
+
+    if(!check(checks, seed))
+        return 2;
+    printf("check: %d frames x scales 1-%d, %s matches scalar\n", checks, MAX_CHECK_SCALE, upscale_isa());
+
+    std::vector<uint8_t> program;
+    if(!load_rom_chip8(rom, program))
+    {
+        std::cerr<<"Could not read "<<rom<<"\n";
+        return 1;
+    }
+    chip8 c;
+    intitialize_chip8(c, program.data(), (int)program.size());
+    std::vector<uint64_t> recorded((size_t)frames * 32);
+    for(int f=0;f<frames;f++)
+    {
+        run_frame_chip8(c, cycles);
+        pack_gfx_chip8(c, &recorded[(size_t)f*32]);
+    }
+
+    double simd = time_frames(recorded, scale, seconds, upscale_rgba);
+    double scalar = time_frames(recorded, scale, seconds, upscale_rgba_scalar);
+    printf("%dx%d, %d frames of %s\n", 64*scale, 32*scale, frames, rom.c_str());
+    printf("  %-8s %10.0f frames/s\n", upscale_isa(), simd);
+    printf("  %-8s %10.0f frames/s\n", "scalar", scalar);
+    printf("  speedup  %10.1fx\n", simd / scalar);
+    return 0;
+}
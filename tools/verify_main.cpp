@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../chip8.h"
+#include "../input_log.h"
+
+// Verify a recorded session (Chip8_emulator --input) against the current emulator, one
+// segment between snapshots per task, spread over all cores.
+//
+// usage: Chip8_verify [--threads N] rom.ch8 session.c8i
+
+int main(int argc, char **argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    std::vector<std::string> files;
+    for(int i=1;i<argc;i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--threads" && i+1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if(arg[0] != '-')
+            files.push_back(arg);
+        else
+        {
+            files.clear();
+            break;
+        }
+    }
+    if(files.size() != 2)
+    {
+        std::cerr<<"usage: "<<argv[0]<<" [--threads N] rom.ch8 session.c8i\n";
+        return 1;
+    }
+
+    std::vector<uint8_t> program;
+    if(!load_rom_chip8(files[0], program))
+    {
+        std::cerr<<"Fail to read "<<files[0]<<"\n";
+        return 1;
+    }
+    input_log log;
+    if(!log.load(files[1]))
+    {
+        std::cerr<<"Fail to read input log "<<files[1]<<"\n";
+        return 1;
+    }
+    if(log.header.rom_hash != rom_hash_chip8(program.data(), program.size()))
+        std::cerr<<"warning: "<<files[1]<<" was recorded with a different ROM\n";
+    if(log.snapshots.empty())
+        std::cerr<<"warning: no snapshots in "<<files[1]<<", verifying as one segment\n";
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<segment_result> results = verify_input_chip8(log, program.data(), program.size(), threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    for(size_t k=0;k<results.size();k++)
+    {
+        const segment_result &r = results[k];
+        if(r.ok)
+            continue;
+        if(failed++ == 0)
+            printf("first divergence in segment %zu (frames %llu-%llu): after frame %llu, within instructions %llu-%llu: %s\n",
+                   k, (unsigned long long)r.first_frame, (unsigned long long)r.last_frame,
+                   (unsigned long long)r.mismatch_frame,
+                   (unsigned long long)(r.mismatch_frame_end - log.header.cycles_per_frame),
+                   (unsigned long long)r.mismatch_frame_end, r.what.c_str());
+    }
+    printf("%zu segments, %llu frames, %u threads, %.3f s: %d diverged\n", results.size(),
+           (unsigned long long)log.frames, threads, seconds, failed);
+    return failed ? 2 : 0;
+}
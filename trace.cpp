@@ -0,0 +1,278 @@
+#include "trace.h"
+#include "disasm.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const uint64_t SYNC_INTERVAL = 256; // records between sync records
+static const size_t MAX_RECORD = 64;       // flags + every field at its largest + opcode
+
+static size_t put_varint(uint8_t *out, uint64_t v){
+    size_t n = 0;
+    while(v >= 0x80){
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool get_varint(const std::vector<uint8_t> &in, size_t &pos, uint64_t &v){
+    v = 0;
+    for(int shift=0;shift<64;shift+=7){
+        if(pos >= in.size())
+            return false;
+        uint8_t b = in[pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if(!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+trace_ring::trace_ring(size_t bytes){
+    size_t n = 256;
+    while(n < bytes)
+        n <<= 1;
+    ring.resize(n);
+    mask = n - 1;
+    // a record is at least 3 bytes, so this many sync points can be inside the ring at once
+    syncs.resize(n / (SYNC_INTERVAL * 3) + 2);
+}
+
+void trace_cycle_chip8(chip8 &c){
+    c.trace->step(c);
+}
+
+void trace_ring::append(const uint8_t *p, size_t n){
+    size_t at = written & mask;
+    size_t first = ring.size() - at < n ? ring.size() - at : n;
+    memcpy(ring.data() + at, p, first);
+    memcpy(ring.data(), p + first, n - first);
+    written += n;
+}
+
+void trace_ring::step(chip8 &c){
+    uint16_t pc = c.PC;
+    uint8_t v[16];
+    memcpy(v, c.V, sizeof(v));
+    uint16_t i = c.I;
+    uint8_t sp = c.SP;
+    uint8_t dt = c.delay_timer, st = c.sound_timer;
+
+    c.trace = nullptr; // run the instruction untraced
+    emulateCyle_chip8(c);
+    c.trace = this;
+
+    uint16_t opcode = c.opcode;
+    // encode straight into the ring unless the record could run past its end
+    uint8_t tmp[MAX_RECORD];
+    size_t at = written & mask;
+    uint8_t *rec = ring.size() - at >= MAX_RECORD ? ring.data() + at : tmp;
+    size_t n = 1;
+    uint8_t flags = 0;
+
+    if(count % SYNC_INTERVAL == 0){
+        flags |= TRACE_SYNC;
+        syncs[sync_count++ % syncs.size()] = written;
+        n += put_varint(rec + n, count);
+        n += put_varint(rec + n, pc);
+    }
+    else if(pc != (uint16_t)(last_pc + 2)){
+        flags |= TRACE_JUMP;
+        int32_t delta = (int32_t)pc - (int32_t)(uint16_t)(last_pc + 2);
+        n += put_varint(rec + n, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    }
+    uint16_t v_mask = 0;
+    uint64_t before[2], after[2];
+    memcpy(before, v, 16);
+    memcpy(after, c.V, 16);
+    if(before[0] != after[0] || before[1] != after[1]) // most instructions touch no register
+        for(int r=0;r<16;r++)
+            if(c.V[r] != v[r])
+                v_mask |= 1 << r;
+    if(v_mask){
+        flags |= TRACE_V;
+        rec[n++] = v_mask & 0xFF;
+        rec[n++] = v_mask >> 8;
+        for(int r=0;r<16;r++)
+            if(v_mask & (1 << r))
+                rec[n++] = c.V[r];
+    }
+    if(c.I != i){
+        flags |= TRACE_I;
+        n += put_varint(rec + n, c.I);
+    }
+    int writes = 0;
+    if((opcode & 0xF0FF) == 0xF033)
+        writes = 3;
+    else if((opcode & 0xF0FF) == 0xF055)
+        writes = ((opcode & 0x0F00)>>8) + 1;
+    if(writes){
+        flags |= TRACE_MEM;
+        n += put_varint(rec + n, i);
+        n += put_varint(rec + n, writes);
+        for(int k=0;k<writes;k++)
+            rec[n++] = c.memory[(i + k) & 0xFFF];
+    }
+    if(c.SP != sp){
+        flags |= TRACE_SP;
+        rec[n++] = c.SP;
+    }
+    if(c.delay_timer != dt || c.sound_timer != st){
+        flags |= TRACE_TIMER;
+        rec[n++] = c.delay_timer;
+        rec[n++] = c.sound_timer;
+    }
+    bool fault = !known_opcode_chip8(opcode) || c.SP > 16 || c.PC > 0xFFE;
+    if(fault)
+        flags |= TRACE_FAULT;
+    rec[0] = flags;
+    rec[n++] = opcode >> 8;
+    rec[n++] = opcode & 0xFF;
+    if(rec == tmp)
+        append(tmp, n);
+    else
+        written += n;
+    last_pc = pc;
+    count++;
+
+    if(fault && fault_count++ == 0 && !fault_path.empty())
+        dump(fault_path);
+}
+
+bool trace_ring::dump(const std::string &path) const {
+    // oldest sync record whose bytes have not been overwritten yet
+    uint64_t oldest = written > ring.size() ? written - ring.size() : 0;
+    uint64_t start = written;
+    uint64_t first = sync_count > syncs.size() ? sync_count - syncs.size() : 0;
+    for(uint64_t s=first;s<sync_count;s++){
+        uint64_t off = syncs[s % syncs.size()];
+        if(off >= oldest){
+            start = off;
+            break;
+        }
+    }
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if(!f)
+        return false;
+    uint64_t len = written - start;
+    uint8_t header[16];
+    for(int b=0;b<4;b++){
+        header[b] = (uint8_t)(TRACE_MAGIC >> (b*8));
+        header[4+b] = (uint8_t)(TRACE_VERSION >> (b*8));
+    }
+    for(int b=0;b<8;b++)
+        header[8+b] = (uint8_t)(len >> (b*8));
+    fwrite(header, 1, sizeof(header), f);
+    for(uint64_t off=start;off<written;){
+        size_t at = off & mask;
+        size_t chunk = ring.size() - at;
+        if(chunk > written - off)
+            chunk = written - off;
+        fwrite(ring.data() + at, 1, chunk, f);
+        off += chunk;
+    }
+    bool ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    return ok;
+}
+
+bool trace_decoder::load(const std::string &path){
+    FILE *f = fopen(path.c_str(), "rb");
+    if(!f)
+        return false;
+    uint8_t header[16];
+    bool ok = fread(header, 1, sizeof(header), f) == sizeof(header);
+    uint32_t magic = 0, version = 0;
+    uint64_t len = 0;
+    for(int b=3;b>=0;b--){
+        magic = magic<<8 | header[b];
+        version = version<<8 | header[4+b];
+    }
+    for(int b=7;b>=0;b--)
+        len = len<<8 | header[8+b];
+    ok = ok && magic == TRACE_MAGIC && version == TRACE_VERSION;
+    if(ok){
+        data.resize(len);
+        ok = fread(data.data(), 1, len, f) == len;
+    }
+    fclose(f);
+    pos = 0;
+    synced = false;
+    return ok;
+}
+
+bool trace_decoder::next(trace_record &r){
+    if(pos >= data.size())
+        return false;
+    uint8_t flags = data[pos++];
+    uint64_t v;
+    r.flags = flags;
+    if(flags & TRACE_SYNC){
+        uint64_t at;
+        if(!get_varint(data, pos, at) || !get_varint(data, pos, v))
+            return false;
+        index = at;
+        pc = (uint16_t)v;
+        synced = true;
+    }
+    else{
+        if(!synced)
+            return false; // dumps always start at a sync record
+        pc += 2;
+        if(flags & TRACE_JUMP){
+            if(!get_varint(data, pos, v))
+                return false;
+            int32_t delta = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            pc = (uint16_t)(pc + delta);
+        }
+    }
+    r.index = index++;
+    r.pc = pc;
+    r.v_mask = 0;
+    if(flags & TRACE_V){
+        if(pos + 2 > data.size())
+            return false;
+        r.v_mask = data[pos] | data[pos+1] << 8;
+        pos += 2;
+        for(int k=0;k<16;k++)
+            if(r.v_mask & (1 << k)){
+                if(pos >= data.size())
+                    return false;
+                r.v[k] = data[pos++];
+            }
+    }
+    if(flags & TRACE_I){
+        if(!get_varint(data, pos, v))
+            return false;
+        r.i = (uint16_t)v;
+    }
+    r.mem.clear();
+    if(flags & TRACE_MEM){
+        uint64_t count;
+        if(!get_varint(data, pos, v) || !get_varint(data, pos, count) || count > 16 || pos + count > data.size())
+            return false;
+        r.mem_addr = (uint16_t)v;
+        r.mem.assign(data.begin() + pos, data.begin() + pos + count);
+        pos += count;
+    }
+    if(flags & TRACE_SP){
+        if(pos >= data.size())
+            return false;
+        r.sp = data[pos++];
+    }
+    if(flags & TRACE_TIMER){
+        if(pos + 2 > data.size())
+            return false;
+        r.delay_timer = data[pos];
+        r.sound_timer = data[pos+1];
+        pos += 2;
+    }
+    if(pos + 2 > data.size())
+        return false;
+    r.opcode = data[pos] << 8 | data[pos+1];
+    pos += 2;
+    return true;
+}
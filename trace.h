@@ -0,0 +1,101 @@
+#ifndef CHIP8_EMULATOR_TRACE_H
+#define CHIP8_EMULATOR_TRACE_H
+
+#include "chip8.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Execution trace: one compact record per instruction in a per machine ring buffer.
+ *
+ * Attach with `c.trace = &ring` (after intitialize_chip8, which detaches). While c.trace is
+ * nullptr the only cost is one predictable branch in emulateCyle_chip8, and none at all when
+ * built with CHIP8_TRACE off.
+ *
+ * Record layout: flags u8 | [fields selected by flags, in this order] | opcode u16 (big endian)
+ *   TRACE_SYNC   varint instruction index, varint PC        (every 256 records, lets a decoder start there)
+ *   TRACE_JUMP   varint zigzag(PC - (previous PC + 2))      (PC is implicit otherwise)
+ *   TRACE_V      u16 mask of changed V registers, new value for each set bit
+ *   TRACE_I      varint new I
+ *   TRACE_MEM    varint address, varint count, bytes        (FX33 / FX55 writes)
+ *   TRACE_SP     u8 new SP
+ *   TRACE_TIMER  u8 delay_timer, u8 sound_timer             (FX15 / FX18)
+ *   TRACE_FAULT  no data: unknown opcode, stack over/underflow or PC outside memory
+ * A straight-line instruction that only changes one register is 5 bytes.
+ */
+
+enum trace_flags : uint8_t {
+    TRACE_SYNC  = 0x01,
+    TRACE_JUMP  = 0x02,
+    TRACE_V     = 0x04,
+    TRACE_I     = 0x08,
+    TRACE_MEM   = 0x10,
+    TRACE_SP    = 0x20,
+    TRACE_TIMER = 0x40,
+    TRACE_FAULT = 0x80,
+};
+
+#define TRACE_MAGIC 0x52543843u // "C8TR"
+#define TRACE_VERSION 1
+
+class trace_ring {
+public:
+    explicit trace_ring(size_t bytes = 1 << 20); // rounded up to a power of two
+
+    // Runs one instruction on `c` and records it. Called by emulateCyle_chip8.
+    void step(chip8 &c);
+
+    // Write the oldest complete part of the ring that still starts at a sync record:
+    //   "C8TR" u32 | version u32 | byte count u64 | records
+    bool dump(const std::string &path) const;
+
+    std::string fault_path; // if set, the ring is dumped here on the first fault
+    uint64_t instructions() const { return count; }
+    uint64_t faults() const { return fault_count; }
+
+private:
+    void append(const uint8_t *p, size_t n);
+
+    std::vector<uint8_t> ring;
+    size_t mask;
+    uint64_t written = 0; // total bytes ever appended
+    uint64_t count = 0;   // instructions recorded
+    uint64_t fault_count = 0;
+    uint16_t last_pc = 0;
+    std::vector<uint64_t> syncs; // byte offsets of sync records, ring of its own
+    uint64_t sync_count = 0;
+};
+
+void trace_cycle_chip8(chip8 &c); // emulateCyle_chip8 with c.trace attached
+
+// One decoded record, as produced by trace_decoder.
+struct trace_record {
+    uint64_t index;
+    uint16_t pc;
+    uint16_t opcode;
+    uint8_t flags;
+    uint16_t v_mask;
+    uint8_t v[16];
+    uint16_t i;
+    uint16_t mem_addr;
+    std::vector<uint8_t> mem;
+    uint8_t sp;
+    uint8_t delay_timer, sound_timer;
+};
+
+class trace_decoder {
+public:
+    bool load(const std::string &path);
+    bool next(trace_record &r); // false at the end or on a corrupt record
+
+private:
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+    uint64_t index = 0;
+    uint16_t pc = 0;
+    bool synced = false;
+};
+
+#endif //CHIP8_EMULATOR_TRACE_H
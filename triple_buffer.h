@@ -0,0 +1,39 @@
+#ifndef CHIP8_EMULATOR_TRIPLE_BUFFER_H
+#define CHIP8_EMULATOR_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer triple buffer.
+// The producer always has a buffer to write into and publish() never waits; the consumer always
+// reads the newest published buffer, frames published in between are dropped.
+// The three slots rotate through an atomic "middle" index that carries a fresh bit.
+template <class T>
+class triple_buffer {
+public:
+    // producer side
+    T &write_buffer() { return buffers[back]; }
+    void publish(){
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // consumer side: true if a newer buffer was swapped in since the last call
+    bool update(){
+        if(!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T &read_buffer() const { return buffers[front]; }
+
+private:
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    T buffers[3] = {};
+    alignas(64) std::atomic<uint8_t> middle{2};
+    alignas(64) uint8_t back = 0;  // owned by the producer
+    alignas(64) uint8_t front = 1; // owned by the consumer
+};
+
+#endif //CHIP8_EMULATOR_TRIPLE_BUFFER_H
@@ -0,0 +1,117 @@
+#include "upscale.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void upscale_rgba_scalar(const uint64_t rows[32], uint32_t *dst, size_t stride, int scale, uint32_t off, uint32_t on){
+    for(int y=0;y<32*scale;y++){
+        uint64_t row = rows[y / scale];
+        uint32_t *out = dst + y*stride;
+        for(int x=0;x<64*scale;x++)
+            out[x] = (row >> (63 - x / scale)) & 1 ? on : off;
+    }
+}
+
+#if defined(__SSE2__) || defined(__AVX2__)
+
+static const int MAX_SIMD_SCALE = 64; // larger scales use the scalar path
+static const int LINE_PAD = 8;        // replication stores may run up to 7 pixels past a span
+
+// Expand one packed row into a line of 64*scale pixels.
+static void expand_line(uint64_t row, uint32_t *line, int scale, uint32_t off, uint32_t on){
+#if defined(__AVX2__)
+    const __m256i sel = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m256i von = _mm256_set1_epi32((int)on);
+    const __m256i voff = _mm256_set1_epi32((int)off);
+    for(int x=0;x<64;x+=8){
+        __m256i bits = _mm256_set1_epi32((int)(row >> (56 - x) & 0xFF));
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(bits, sel), sel);
+        __m256i px = _mm256_blendv_epi8(voff, von, mask); // 8 pixels, leftmost first
+        uint32_t *out = line + x*scale;
+        if(scale == 1){
+            _mm256_storeu_si256((__m256i *)out, px);
+            continue;
+        }
+        for(int i=0;i<8;i++){
+            __m256i one = _mm256_permutevar8x32_epi32(px, _mm256_set1_epi32(i));
+            for(int k=0;k<scale;k+=8)
+                _mm256_storeu_si256((__m256i *)(out + i*scale + k), one);
+        }
+    }
+#else
+    const __m128i sel = _mm_setr_epi32(0x8, 0x4, 0x2, 0x1);
+    const __m128i von = _mm_set1_epi32((int)on);
+    const __m128i voff = _mm_set1_epi32((int)off);
+    for(int x=0;x<64;x+=4){
+        __m128i bits = _mm_set1_epi32((int)(row >> (60 - x) & 0xF));
+        __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(bits, sel), sel);
+        __m128i px = _mm_or_si128(_mm_and_si128(mask, von), _mm_andnot_si128(mask, voff)); // 4 pixels
+        uint32_t *out = line + x*scale;
+        switch(scale){
+            case 1:
+                _mm_storeu_si128((__m128i *)out, px);
+                break;
+            case 2:
+                _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi32(px, px));
+                _mm_storeu_si128((__m128i *)(out + 4), _mm_unpackhi_epi32(px, px));
+                break;
+            default:{
+                __m128i lane[4] = {_mm_shuffle_epi32(px, 0x00), _mm_shuffle_epi32(px, 0x55),
+                                   _mm_shuffle_epi32(px, 0xAA), _mm_shuffle_epi32(px, 0xFF)};
+                for(int i=0;i<4;i++)
+                    for(int k=0;k<scale;k+=4)
+                        _mm_storeu_si128((__m128i *)(out + i*scale + k), lane[i]);
+            }
+        }
+    }
+#endif
+}
+
+void upscale_rgba(const uint64_t rows[32], uint32_t *dst, size_t stride, int scale, uint32_t off, uint32_t on){
+    if(scale < 1)
+        return;
+    if(scale > MAX_SIMD_SCALE){
+        upscale_rgba_scalar(rows, dst, stride, scale, off, on);
+        return;
+    }
+    uint32_t line[64 * MAX_SIMD_SCALE + LINE_PAD];
+    size_t width = 64 * (size_t)scale;
+    const uint32_t *prev = nullptr;
+    for(int y=0;y<32;y++){
+        uint32_t *out = dst + (size_t)y*scale*stride;
+        if(prev && rows[y] == rows[y-1])
+            memcpy(out, prev, width * 4); // same as the row above, reuse it
+        else{
+            expand_line(rows[y], line, scale, off, on);
+            memcpy(out, line, width * 4);
+        }
+        for(int r=1;r<scale;r++)
+            memcpy(out + r*stride, out, width * 4);
+        prev = out;
+    }
+}
+
+const char *upscale_isa(){
+#if defined(__AVX2__)
+    return "avx2";
+#else
+    return "sse2";
+#endif
+}
+
+#else
+
+void upscale_rgba(const uint64_t rows[32], uint32_t *dst, size_t stride, int scale, uint32_t off, uint32_t on){
+    upscale_rgba_scalar(rows, dst, stride, scale, off, on);
+}
+
+const char *upscale_isa(){
+    return "scalar";
+}
+
+#endif
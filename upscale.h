@@ -0,0 +1,24 @@
+#ifndef CHIP8_EMULATOR_UPSCALE_H
+#define CHIP8_EMULATOR_UPSCALE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Nearest neighbour upscale of a packed 64x32 frame (pack_gfx_chip8 layout) to 32-bit pixels.
+//
+//   dst       caller provided, at least 32*scale rows of `stride` pixels
+//   stride    pixels per destination row, >= 64*scale
+//   scale     integer scale factor >= 1 (20 gives 1280x640)
+//   off / on  colours of unlit / lit pixels, written as is (e.g. 0xFF000000 for opaque black RGBA)
+//
+// Bits are expanded with SSE2 (or AVX2 when compiled with it) and every output row is built
+// once and copied for the vertical repeat. Builds without SSE2 use the plain C++ path.
+void upscale_rgba(const uint64_t rows[32], uint32_t *dst, size_t stride, int scale, uint32_t off, uint32_t on);
+
+// Reference version, pixel by pixel.
+void upscale_rgba_scalar(const uint64_t rows[32], uint32_t *dst, size_t stride, int scale, uint32_t off, uint32_t on);
+
+// Instruction set upscale_rgba was built with: "avx2", "sse2" or "scalar".
+const char *upscale_isa();
+
+#endif //CHIP8_EMULATOR_UPSCALE_H